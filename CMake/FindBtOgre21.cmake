@@ -15,3 +15,7 @@ mark_as_advanced(BtOgre21_INCLUDE_DIR BtOgre21_LIBRARY BtOgre21_DEBUG_LIBRARY)
 set(BtOgre21_INCLUDE_DIRS ${BtOgre21_INCLUDE_DIR})
 set(BtOgre21_LIBRARIES optimized ${BtOgre21_LIBRARY} debug ${BtOgre21_DEBUG_LIBRARY})
 
+#BtOgre21 is a static library that uses std::thread
+find_package(Threads REQUIRED)
+list(APPEND BtOgre21_LIBRARIES ${CMAKE_THREAD_LIBS_INIT})
+
@@ -21,3 +21,19 @@
 #include "BtOgreGP.h"
 #include "BtOgrePG.h"
 #include "BtOgreExtras.h"
+#include "BtOgreShapeCache.h"
+#include "BtOgreBvhCache.h"
+#include "BtOgreThreadPool.h"
+#include "BtOgreVertexKernels.h"
+#include "BtOgreConvexHull.h"
+#include "BtOgreConvexDecomposition.h"
+#include "BtOgreMeshSimplifier.h"
+#include "BtOgreHeightfield.h"
+#include "BtOgreQuantizedMesh.h"
+#include "BtOgreTiledTrimesh.h"
+#include "BtOgreSkeletonShape.h"
+#include "BtOgreSkinnedMesh.h"
+#include "BtOgreOrientedBox.h"
+#include "BtOgreAsyncConverter.h"
+#include "BtOgreBatchConverter.h"
+#include "BtOgreMemoryStats.h"
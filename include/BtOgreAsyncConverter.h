@@ -0,0 +1,98 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreAsyncConverter.h
+ *
+ *    Description:  Asynchronous front end of the mesh to shape converters, for content
+ *                  streamed in while rendering.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "BtOgreGP.h"
+
+namespace BtOgre
+{
+	///Convert meshes to shapes without blocking the render thread. The Ogre side of a conversion (readback requests, mapping and
+	///unmapping, v1 buffer locks) happens in update(), called once per frame on the render thread. The rest (decoding, welding, BVH
+	///or hull building...) runs on a ThreadPool. A v2 mesh is only mapped once its GPU transfer is done, so update() never stalls on it.
+	///Items and entities given to convert() must stay alive until the next update()
+	class AsyncConverter
+	{
+	public:
+		///Build a shape out of a filled converter. Runs on a worker thread
+		using ShapeBuilder = std::function<btCollisionShape*(StaticMeshToShapeConverter& converter)>;
+
+		///Receive a finished shape, or nullptr if building it failed. Called from update(), on the render thread
+		using Callback = std::function<void(btCollisionShape* shape)>;
+
+		///Run the CPU side of the conversions on this pool
+		explicit AsyncConverter(ThreadPool* pool = &ThreadPool::getSingleton());
+
+		///Wait for the conversions running on the pool and release their readbacks. Must run on the render thread.
+		///The conversions that didn't start are dropped, their futures get a broken promise
+		~AsyncConverter();
+
+		///Not copyable
+		AsyncConverter(const AsyncConverter&) = delete;
+
+		///Not copyable
+		AsyncConverter& operator=(const AsyncConverter&) = delete;
+
+		///Get a builder that calls createShape(kind), or createOwningTrimesh() for ShapeKind::Trimesh
+		static ShapeBuilder makeBuilder(ShapeKind kind);
+
+		///Convert a v2 Item. The future gets the shape, or the exception the builder threw
+		std::future<btCollisionShape*> convert(Ogre::Item* item, ShapeBuilder builder, const MeshLod& lod = MeshLod());
+
+		///Convert a v1 Entity. The future gets the shape, or the exception the builder threw
+		std::future<btCollisionShape*> convert(Ogre::v1::Entity* entity, ShapeBuilder builder, const MeshLod& lod = MeshLod());
+
+		///Convert a v2 Item and give the shape to callback
+		void convert(Ogre::Item* item, ShapeBuilder builder, Callback callback, const MeshLod& lod = MeshLod());
+
+		///Convert a v1 Entity and give the shape to callback
+		void convert(Ogre::v1::Entity* entity, ShapeBuilder builder, Callback callback, const MeshLod& lod = MeshLod());
+
+		///Move the conversions forward: send the readback requests of the new ones, map the transfers that are done and hand them to
+		///the pool, unmap the ones the pool decoded, and call the callbacks of the finished ones. Call it once per frame, on the render thread
+		void update();
+
+		///Get the number of conversions not delivered yet. Call it on the render thread
+		size_t getPendingCount() const;
+
+	private:
+		///A conversion and where it stands
+		struct Job;
+
+		///Queue a job for the next update()
+		void push(std::shared_ptr<Job> job);
+
+		///Start the CPU side of a job on the pool
+		void startBuild(const std::shared_ptr<Job>& job, bool decode);
+
+		///Pool the CPU side runs on
+		ThreadPool* mPool;
+
+		///Jobs queued by convert(), not seen by update() yet
+		std::vector<std::shared_ptr<Job>> mQueued;
+
+		///Jobs update() is moving forward. Only touched on the render thread
+		std::vector<std::shared_ptr<Job>> mActive;
+
+		///Protect mQueued
+		mutable std::mutex mMutex;
+	};
+}
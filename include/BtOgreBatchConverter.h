@@ -0,0 +1,102 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreBatchConverter.h
+ *
+ *    Description:  Conversion of many items at once, with a single GPU readback sync.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BtOgreGP.h"
+#include "BtOgreAsyncConverter.h"
+
+namespace BtOgre
+{
+	///Time spent in each phase of the last BatchConverter run, in milliseconds
+	struct BatchTimings
+	{
+		///Sending the read requests of every mesh
+		double request;
+
+		///Mapping the tickets, which waits for the GPU once, and unmapping them
+		double sync;
+
+		///Decoding the mapped data
+		double decode;
+
+		///Building the shapes
+		double build;
+	};
+
+	///Convert many items and meshes (a room, a streamed cell...) together. Every read request is sent before anything is mapped,
+	///so the GPU to CPU transfers are waited on once instead of once per item. Then everything is decoded, and the shapes built,
+	///in parallel. Runs on the render thread, the pool does the CPU work
+	class BatchConverter
+	{
+	public:
+		///Build a shape out of a filled converter. Runs on a worker thread
+		using ShapeBuilder = AsyncConverter::ShapeBuilder;
+
+		///Run the CPU side of the conversions on this pool. nullptr to do everything on the calling thread
+		explicit BatchConverter(ThreadPool* pool = &ThreadPool::getSingleton());
+
+		///Add an item. Its scale is taken from its node when the batch is read. The transform places the item, it shouldn't
+		///include the node's scale: the scale is applied to the mesh first, it would be applied twice
+		void add(Ogre::Item* item, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
+
+		///Add a mesh, scaled by scale then placed by transform. The transform shouldn't include the scale
+		void add(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY,
+			const Ogre::Vector3& scale = Ogre::Vector3::UNIT_SCALE, const MeshLod& lod = MeshLod());
+
+		///Get the number of items and meshes added
+		size_t getCount() const { return mEntries.size(); }
+
+		///Remove all the items and meshes
+		void clear();
+
+		///Read all the items and meshes back. Get one filled converter for each, in the order they were added
+		std::vector<std::unique_ptr<StaticMeshToShapeConverter>> read();
+
+		///Read all the items and meshes back, and build one shape for each, in the order they were added.
+		///Empty meshes get nullptr. If a builder throws, the shapes already built are deleted
+		std::vector<btCollisionShape*> convert(const ShapeBuilder& builder);
+
+		///Read all the items and meshes back, and build a single shape out of all of them.
+		///Scales then transforms are baked in the vertices, the shape is in the space the transforms lead to
+		btCollisionShape* convertMerged(const ShapeBuilder& builder);
+
+		///Get the time spent in each phase by the last run. The build time is 0 after read()
+		const BatchTimings& getTimings() const { return mTimings; }
+
+	private:
+		///An item or a mesh to convert
+		struct Entry
+		{
+			Ogre::Item* item;
+			const Ogre::Mesh* mesh;
+			Ogre::Matrix4 transform;
+			Ogre::Vector3 scale;
+			MeshLod lod;
+		};
+
+		///Call body(i) for i in [0, count), on the pool if there's one
+		void forEach(size_t count, const std::function<void(size_t)>& body);
+
+		///Log the timings of the last run
+		void logTimings() const;
+
+		ThreadPool* mPool;
+		std::vector<Entry> mEntries;
+		BatchTimings mTimings;
+	};
+}
@@ -0,0 +1,69 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreBvhCache.h
+ *
+ *    Description:  On-disk cache of the BVH and internal edge information of static
+ *                  triangle meshes, so they're not rebuilt on every launch.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "BtOgreGP.h"
+
+namespace BtOgre
+{
+	///Directory of serialized BVHs and triangle info maps, keyed by a hash of the mesh data they were built from.
+	///The BVH is stored with btOptimizedBvh's in place serialization, so loading it is a single read.
+	///An entry that doesn't match the mesh anymore (different content, Bullet precision or format version), or whose sizes don't match
+	///the length of the file (truncated or corrupted), is rebuilt and overwritten. Entries are written to a temporary file unique to the
+	///process and thread, then moved in place
+	class BvhCache
+	{
+	public:
+		///Use the given directory to store the cache files. The directory must exist
+		explicit BvhCache(std::string directory);
+
+		///Create a trimesh shape from these buffers, taking ownership of them. Load its BVH from the cache, or build it and save it
+		/// \param scaling Scaling to apply to the mesh, it's part of the BVH
+		/// \param name Name of the cache entry. If empty, the content hash is used as a name
+		/// \param internalEdgeInfo Also generate (or load) a btTriangleInfoMap for the shape
+		OwningBvhTriangleMeshShape* createTrimesh(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling,
+			const std::string& name = "", bool internalEdgeInfo = false);
+
+		///Compute the hash that identify the content of a trimesh
+		static uint64_t hashContent(const VertexBuffer& vertices, const IndexBuffer& indices, const btVector3& scaling);
+
+		///Get the file used to store the given entry
+		std::string getEntryPath(const std::string& name, uint64_t contentHash) const;
+
+		///Number of shapes that were loaded from the cache
+		size_t getLoadCount() const { return mLoads; }
+
+		///Number of shapes that had to be built (missing or stale entry)
+		size_t getBuildCount() const { return mBuilds; }
+
+	private:
+		///Try to load the BVH (and triangle info map) of this shape from the given file
+		static bool load(const std::string& path, uint64_t contentHash, OwningBvhTriangleMeshShape* shape, bool internalEdgeInfo);
+
+		///Write the BVH (and triangle info map) of this shape to the given file
+		static bool save(const std::string& path, uint64_t contentHash, OwningBvhTriangleMeshShape* shape);
+
+		///Where the files are stored
+		std::string mDirectory;
+
+		///Statistics
+		std::atomic<size_t> mLoads, mBuilds;
+	};
+}
@@ -0,0 +1,69 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreConvexDecomposition.h
+ *
+ *    Description:  Approximate convex decomposition of a triangle mesh into a compound
+ *                  of convex hulls, for concave dynamic bodies.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreVector3.h>
+
+#include "BtOgreThreadPool.h"
+
+namespace BtOgre
+{
+	///Tuning of a ConvexDecomposition
+	struct ConvexDecompositionSettings
+	{
+		///Maximum number of hulls in the result
+		unsigned maxHulls = 16;
+
+		///A part is split while it's deeper than this inside its hull, as a fraction of the mesh bounding box diagonal
+		Ogre::Real concavity = 0.01f;
+
+		///Vertex budget of each hull, see ConvexHullBuilder
+		unsigned maxVerticesPerHull = 32;
+
+		///Number of cutting planes tried on each axis when a part is split
+		unsigned planesPerAxis = 7;
+	};
+
+	///Split a mesh into nearly convex parts, and build a btCompoundShape of their convex hulls.
+	///A part is split in two along the axis aligned plane that minimizes the volume of the two child hulls. The part to split next
+	///is the most concave one, its concavity being the depth of its hull surface above the mesh, measured by rays cast inward
+	///from the hull faces. The mesh triangles must be consistently wound (counter clockwise seen from outside).
+	///Candidate planes, parts of a round and hulls are processed on a ThreadPool. The result doesn't depend on the number of threads
+	class ConvexDecomposition
+	{
+	public:
+		///Use these settings
+		explicit ConvexDecomposition(const ConvexDecompositionSettings& settings = ConvexDecompositionSettings());
+
+		///Get the settings
+		const ConvexDecompositionSettings& getSettings() const;
+
+		///Split the mesh into parts. Get the vertices of each part
+		std::vector<std::vector<Ogre::Vector3>> decompose(const Ogre::Vector3* vertices, size_t vertexCount,
+			const unsigned* indices, size_t indexCount, ThreadPool* pool = &ThreadPool::getSingleton()) const;
+
+		///Decompose the mesh and build a compound of the part hulls. Each hull is centered on its part, and scaled with scaling
+		btCompoundShape* build(const Ogre::Vector3* vertices, size_t vertexCount,
+			const unsigned* indices, size_t indexCount,
+			const btVector3& scaling = btVector3(1, 1, 1), ThreadPool* pool = &ThreadPool::getSingleton()) const;
+
+	private:
+		ConvexDecompositionSettings mSettings;
+	};
+}
@@ -0,0 +1,72 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreConvexHull.h
+ *
+ *    Description:  Build convex hull shapes that only keep a limited number of
+ *                  vertices, with their polyhedral features precomputed.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "BtOgreGP.h"
+
+namespace BtOgre
+{
+	///Points a hull is built from. They are only read, and must stay alive until the hull is built
+	struct PointSet
+	{
+		const Ogre::Vector3* points;
+		size_t count;
+	};
+
+	///Compute the real convex hull of a point cloud, then reduce it to a vertex budget.
+	///The reduction is greedy: starting from a tetrahedron spanning the hull, the hull vertex the farthest outside
+	///the current approximation is added until the budget is reached or every hull vertex is within the error.
+	///The approximation is always inside the real hull. Build methods don't modify the builder, they can be called from several threads
+	class ConvexHullBuilder
+	{
+	public:
+		///Keep at most vertexBudget vertices (at least 4). Stop adding vertices once the hull is within maxError of the real one
+		explicit ConvexHullBuilder(unsigned vertexBudget = 64, Ogre::Real maxError = 0);
+
+		///Set the maximum number of vertices of the hulls
+		void setVertexBudget(unsigned vertexBudget);
+
+		///Get the maximum number of vertices of the hulls
+		unsigned getVertexBudget() const;
+
+		///Set the distance under which a hull vertex doesn't need to be kept
+		void setMaxError(Ogre::Real maxError);
+
+		///Get the distance under which a hull vertex doesn't need to be kept
+		Ogre::Real getMaxError() const;
+
+		///Set if initializePolyhedralFeatures() is called on the built shapes. Default is true
+		void setPolyhedralFeatures(bool polyhedralFeatures);
+
+		///Compute the vertices of the reduced hull of these points
+		/// \param error If not null, receives the distance of the farthest real hull vertex outside the reduced hull
+		std::vector<Ogre::Vector3> computeHull(const Ogre::Vector3* points, size_t count, Ogre::Real* error = nullptr) const;
+
+		///Build a convex hull shape from these points. The scaling is applied before the polyhedral features are computed
+		btConvexHullShape* build(const Ogre::Vector3* points, size_t count,
+			const btVector3& scaling = btVector3(1, 1, 1), Ogre::Real* error = nullptr) const;
+
+		///Build one shape per point set on the given pool (nullptr to use the calling thread only). Results are in the same order
+		std::vector<btConvexHullShape*> build(const std::vector<PointSet>& pointSets, ThreadPool* pool = &ThreadPool::getSingleton()) const;
+
+	private:
+		unsigned mVertexBudget;
+		Ogre::Real mMaxError;
+		bool mPolyhedralFeatures;
+	};
+}
@@ -17,8 +17,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btTriangleInfoMap.h>
 #include <Ogre.h>
 #include <OgreMesh2.h>
 #include <OgreSubMesh2.h>
@@ -31,7 +37,15 @@
 #include <Vao/OgreVertexElements.h>
 
 #include "BtOgreExtras.h"
-#include "BtOgre.hpp"
+#include "BtOgreThreadPool.h"
+#include "BtOgreConvexDecomposition.h"
+#include "BtOgreMeshSimplifier.h"
+#include "BtOgreHeightfield.h"
+#include "BtOgreQuantizedMesh.h"
+#include "BtOgreTiledTrimesh.h"
+#include "BtOgreSkeletonShape.h"
+#include "BtOgreOrientedBox.h"
+#include "BtOgreMemoryStats.h"
 
 #if (defined(OGRE_NEXT_VERSION) && OGRE_NEXT_VERSION >= 0x30000) || OGRE_VERSION_MINOR > 3
 #define OGRE_VertexArrayObject_ReadRequests VertexArrayObject::ReadRequestsVec
@@ -41,8 +55,10 @@
 
 namespace BtOgre
 {
-	using BoneIndex = std::map<unsigned, Vector3Array*>;
-	using BoneKeyIndex = std::pair<unsigned, Vector3Array*>;
+	class BvhCache;
+
+	///Min/max corners of the vertices of each bone, indexed by bone. Empty bones have minimum > maximum
+	using BoneBounds = std::vector<std::pair<Ogre::Vector3, Ogre::Vector3>>;
 
 	///Type of a vertex buffer is an vector of Vector3
 	using VertexBuffer = std::vector<Ogre::Vector3>;
@@ -50,6 +66,158 @@ namespace BtOgre
 	///Type of an index buffer is an array of unsigned ints
 	using IndexBuffer = std::vector<unsigned int>;
 
+	///Type of a 16 bits index buffer, used by the shapes when the indices fit
+	using ShortIndexBuffer = std::vector<uint16_t>;
+
+	///The different kinds of collision shapes a VertexIndexToShape can produce
+	enum class ShapeKind
+	{
+		Sphere,
+		Box,
+		Cylinder,
+		Capsule,
+		Convex,
+		Trimesh,
+		ConvexDecomposition,
+		Skeleton ///<Bone shapes of a skeleton, see AnimatedMeshToShapeConverter::createSkeletonShape. createShape() gives nullptr
+	};
+
+	///Which level of detail of a mesh to extract: a LOD level, or the most detailed level that fits a triangle budget.
+	///Converts from a LOD level, so a plain number can be passed where a MeshLod is expected
+	struct MeshLod
+	{
+		///Use this LOD level. The nearest existing one is used if the mesh has less levels
+		MeshLod(unsigned short level = 0);
+
+		///Use the most detailed LOD that has at most maxTriangles triangles, or the least detailed one if none does
+		static MeshLod triangleBudget(size_t maxTriangles);
+
+		///Get the LOD level to use for this mesh
+		unsigned short resolve(const Ogre::Mesh* mesh) const;
+
+		///Get the LOD level to use for this v1 mesh
+		unsigned short resolve(const Ogre::v1::Mesh* mesh) const;
+
+		///Number of triangles of the given LOD level of a mesh
+		static size_t getTriangleCount(const Ogre::Mesh* mesh, unsigned short level);
+
+		///Number of triangles of the given LOD level of a v1 mesh
+		static size_t getTriangleCount(const Ogre::v1::Mesh* mesh, unsigned short level);
+
+		///Requested level, when there's no triangle budget
+		unsigned short level;
+
+		///Triangle budget, 0 if a level is requested
+		size_t maxTriangles;
+	};
+
+	///Vertex and triangle counts before and after VertexIndexToShape::weldVertices()
+	struct WeldStatistics
+	{
+		size_t verticesBefore;
+		size_t verticesAfter;
+		size_t trianglesBefore;
+		size_t trianglesAfter;
+	};
+
+	///How well a candidate primitive of VertexIndexToShape::createBestFit() fits the vertices
+	struct PrimitiveFit
+	{
+		///Kind of the candidate
+		ShapeKind kind;
+
+		///True if the candidate follows the axes of the fitted box instead of the axes of the mesh
+		bool oriented;
+
+		///Volume of the candidate over the volume of the convex hull of the vertices. 1 is a perfect fit, hulls can be under 1
+		Ogre::Real volumeRatio;
+	};
+
+	///What VertexIndexToShape::createBestFit() measured and picked
+	struct BestFitReport
+	{
+		///Volume of the convex hull of the vertices
+		Ogre::Real hullVolume;
+
+		///Every candidate, cheapest to collide first
+		std::vector<PrimitiveFit> candidates;
+
+		///Index of the picked candidate
+		size_t picked;
+	};
+
+	namespace detail
+	{
+		///Storage for OwningBvhTriangleMeshShape. Declared as the first base so it is constructed before the Bullet shape that points into it
+		struct TrimeshStorage
+		{
+			///Take ownership of the given buffers and describe them to Bullet with the given scaling.
+			///Indices are narrowed to 16 bits when the triangles can be split in PHY_SHORT parts, each one spanning less than 65536
+			///vertices from its own vertex base. Otherwise they're kept as a single PHY_INTEGER part
+			TrimeshStorage(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling);
+
+			///Try to describe the mesh as PHY_SHORT parts. Leaves everything untouched and returns false if it can't
+			bool addShortParts();
+
+			///Describe the mesh as a single PHY_INTEGER part
+			void addIntegerPart();
+
+			///Vertex buffer referenced by the mesh interface
+			VertexBuffer mVertices;
+
+			///32 bits index buffer referenced by the mesh interface. Empty if the indices were narrowed
+			IndexBuffer mIndices;
+
+			///16 bits index buffer referenced by the mesh interface, relative to the vertex base of their part. Empty if not narrowed
+			ShortIndexBuffer mShortIndices;
+
+			///Bullet view on the buffers above. Doesn't copy anything
+			btTriangleIndexVertexArray mMeshInterface;
+		};
+	}
+
+	///BVH triangle mesh shape that owns its vertex and index data. Deleting the shape frees everything, nothing to clean up by hand.
+	class OwningBvhTriangleMeshShape : private detail::TrimeshStorage, public btBvhTriangleMeshShape
+	{
+	public:
+		///Move the buffers in and build the BVH directly on top of them. The scaling is applied before the BVH is built, so it's only built once
+		OwningBvhTriangleMeshShape(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling = btVector3(1, 1, 1),
+			bool useQuantizedAabbCompression = true, bool buildBvh = true);
+
+		///Free the adopted BVH buffer and triangle info map, if any
+		virtual ~OwningBvhTriangleMeshShape();
+
+		///Use a BVH that was deserialized in place in buffer. buffer must come from btAlignedAlloc, the shape takes ownership of it.
+		///The shape must have been created without building its own BVH
+		void adoptSerializedBvh(void* buffer, btOptimizedBvh* bvh);
+
+		///Run Bullet's internal edge detection on this mesh and keep the resulting map. Use with btAdjustInternalEdgeContacts in a contact callback
+		btTriangleInfoMap* generateInternalEdgeInfo();
+
+		///Use this triangle info map, the shape takes ownership of it
+		void adoptTriangleInfoMap(btTriangleInfoMap* triangleInfoMap);
+
+		///Get the vertex buffer used by this shape
+		const VertexBuffer& getVertexBuffer() const { return mVertices; }
+
+		///Get the 32 bits index buffer used by this shape. Empty if the shape uses 16 bits indices
+		const IndexBuffer& getIndexBuffer() const { return mIndices; }
+
+		///Get the 16 bits index buffer used by this shape. Indices are relative to the vertex base of their part, see getMeshInterface()
+		const ShortIndexBuffer& getShortIndexBuffer() const { return mShortIndices; }
+
+		///Get the type of the indices given to Bullet, PHY_SHORT or PHY_INTEGER
+		PHY_ScalarType getIndexType() const { return mShortIndices.empty() ? PHY_INTEGER : PHY_SHORT; }
+
+	private:
+
+		///Memory block holding a BVH deserialized in place, or nullptr if the BVH is built by Bullet
+		void* mSerializedBvh;
+
+		///Triangle info map owned by this shape
+		std::unique_ptr<btTriangleInfoMap> mOwnedTriangleInfoMap;
+	};
+
 	///
 	/// Converter from vertex and index buffer to Bullet BtCollisionShape. Load vertex and index buffer from Ogre Item, Etity, Mesh and v1::Mesh
 	///
@@ -57,16 +225,22 @@ namespace BtOgre
 	{
 	public:
 		VertexIndexToShape(const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
-		virtual ~VertexIndexToShape();
+		virtual ~VertexIndexToShape() = default;
+
+		///Copies count their buffers again. Moves hand the buffers and their memory accounting over, see MemoryStats
+		VertexIndexToShape(const VertexIndexToShape&) = default;
+		VertexIndexToShape(VertexIndexToShape&&) = default;
+		VertexIndexToShape& operator=(const VertexIndexToShape&) = default;
+		VertexIndexToShape& operator=(VertexIndexToShape&&) = default;
 
-		///Get the object bounding radius
-		Ogre::Real getRadius();
+		///Get the object bounding radius. Bounds are tracked while vertices are added, this doesn't scan the vertex buffer
+		Ogre::Real getRadius() const;
 
-		///Get the object bounding size vector
-		Ogre::Vector3 getSize();
+		///Get the object bounding size vector. Zero if there's no vertex
+		Ogre::Vector3 getSize() const;
 
 		///Get the offset of object bounding box center from (0,0,0) point in mesh
-		Ogre::Vector3 getCenterOffset();
+		Ogre::Vector3 getCenterOffset() const;
 
 		///Return a spherical bullet collision shape from this object
 		btSphereShape* createSphere();
@@ -77,15 +251,61 @@ namespace BtOgre
 		///Return a triangular mesh collision shape from this object
 		btBvhTriangleMeshShape* createTrimesh();
 
+		///Return a triangular mesh collision shape that uses the converter's buffers without copying them.
+		///The vertex and index buffers are moved into the returned shape: this converter is empty afterwards.
+		OwningBvhTriangleMeshShape* createOwningTrimesh();
+
+		///Same as createOwningTrimesh(), but the BVH (and optionally the internal edge info) is loaded from the cache if it's there and up to date.
+		///Otherwise it's built and saved to the cache
+		/// \param name Name of the cache entry, like the mesh name. If empty, the content hash is used
+		OwningBvhTriangleMeshShape* createCachedTrimesh(BvhCache& cache, const std::string& name = "", bool internalEdgeInfo = false);
+
+		///Return a heightfield collision shape if the buffers are a regular grid in the XZ plane (see Heightfield::detectGrid()), nullptr otherwise.
+		///Only one float per sample is kept. Place the shape at originOffset (in the converter's space) for it to match the mesh
+		OwningHeightfieldTerrainShape* createHeightfield(Ogre::Vector3& originOffset, Ogre::Real tolerance = 1e-4f) const;
+
+		///Return a triangular mesh collision shape with positions quantized to 16 bits per component in chunks of at most maxChunkTriangles
+		///triangles (see QuantizedMeshInterface). Its memory use and precision are logged.
+		///With compareWithFloat, the shape createOwningTrimesh() would give is built on copies of the buffers, and its memory use and
+		///query throughput (see QueryBenchmark) are logged next to the quantized shape's. That doubles the cost: keep it for tuning
+		QuantizedBvhTriangleMeshShape* createQuantizedTrimesh(unsigned maxChunkTriangles = 4096, bool compareWithFloat = false) const;
+
+		///Return a compound of triangular mesh tiles, each with its own BVH, for meshes too large for a single one (see TiledTrimeshShape).
+		///The tiles are built on the converter's thread pool
+		TiledTrimeshShape* createTiledTrimesh(const TilingSettings& settings = TilingSettings()) const;
+
+		///Return a collision shape of the given kind. Trimeshes are created with createOwningTrimesh()
+		btCollisionShape* createShape(ShapeKind kind);
+
 		///Return a cynlinder collision shape from this object
 		btCylinderShape* createCylinder();
 
 		///Return a convex hull  collision shape from this object
 		btConvexHullShape* createConvex();
 
+		///Return a convex hull collision shape with at most vertexBudget vertices, with its polyhedral features initialized. See ConvexHullBuilder.
+		///Only reads the vertex buffer: converters filled on the Ogre thread can build their hulls on worker threads
+		/// \param maxError Stop adding vertices once every vertex of the real hull is within that distance
+		/// \param error If not null, receives the distance of the farthest real hull vertex outside the returned hull
+		btConvexHullShape* createReducedConvex(unsigned vertexBudget = 64, Ogre::Real maxError = 0, Ogre::Real* error = nullptr) const;
+
+		///Return a compound of convex hulls approximating this object, for concave dynamic bodies. See ConvexDecomposition.
+		///Runs on the converter's thread pool. The child hulls have to be deleted with the compound
+		btCompoundShape* createConvexDecomposition(const ConvexDecompositionSettings& settings = ConvexDecompositionSettings()) const;
+
 		///Return a capsule shape from this object
 		btCapsuleShape* createCapsule();
 
+		///Return a box of close to minimum volume around the vertices, and where to place it (see OrientedBoxFitter).
+		///Tighter than createBox() for objects that aren't aligned on their axes
+		btBoxShape* createFittedBox(btTransform& transform) const;
+
+		///Return the cheapest primitive containing the vertices whose volume is within tolerance of the volume of their convex hull:
+		///a sphere, a capsule, a box, an oriented box or a cylinder, tried in that order. Falls back to a reduced convex hull
+		///(see createReducedConvex()). The fit of every candidate is logged, and written to report if it isn't null
+		/// \param transform Receives where to place the shape
+		btCollisionShape* createBestFit(Ogre::Real tolerance, btTransform& transform, BestFitReport* report = nullptr) const;
+
 		///Get the vertex buffer (array of vector 3)
 		const Ogre::Vector3* getVertices();
 
@@ -101,8 +321,62 @@ namespace BtOgre
 		///Get the number of triangles
 		size_t getTriangleCount() const;
 
+		///Merge the vertices closer than epsilon to each other and remap the index buffer, then drop the triangles that became degenerate.
+		///Meshes split their positions at normal, UV and tangent seams; the collision shapes don't need these duplicates.
+		///Uses a hash grid, runs in linear time. An epsilon of 0 only merges identical positions. The counts are also logged
+		WeldStatistics weldVertices(Ogre::Real epsilon = 1e-5f);
+
+		///Simplify the buffers with quadric edge collapse (see MeshSimplifier) before a shape is created from them.
+		///Stops at targetTriangles (0 for no target) or before the error would exceed maxError. Call weldVertices() first. The counts are also logged
+		SimplifyStatistics simplify(size_t targetTriangles, Ogre::Real maxError = std::numeric_limits<Ogre::Real>::max(), bool preserveBorders = true);
+
+		///Get the memory held by the buffers of this converter, its peak, and the memory of the shapes it created.
+		///Temporary buffers of the conversion functions aren't counted. Process-wide totals are in MemoryStats
+		ConverterMemoryStats getMemoryStats() const;
+
+		///Start measuring the peak from the memory held by the buffers now
+		void resetMemoryPeak();
+
+		///Set the pool used to process submeshes in parallel. nullptr to do everything on the calling thread. Default is ThreadPool::getSingleton()
+		void setThreadPool(ThreadPool* pool);
+
+		///Set the scale applied to the shapes. The constructors taking an Item or an Entity get it from its node.
+		///Each scale builds its own shape: for many scaled copies of a mesh, leave it at 1 and use ShapeCache::createScaledInstance()
+		void setScale(const Ogre::Vector3& scale);
+
+		///Get the scale applied to the shapes
+		const Ogre::Vector3& getScale() const { return mScale; }
+
+		///Append the vertices and triangles of another converter. Its scale is applied in the space of its meshes, before its transform
+		///(the one of the last mesh it read), and baked in the vertices relative to this converter's scale
+		void merge(const VertexIndexToShape& other);
+
 	protected:
 
+		///Forget the bounds, for when the vertex buffer is emptied
+		void resetBounds();
+
+		///Compute the bounds from the whole vertex buffer, after vertices were removed
+		void recomputeBounds();
+
+		///Grow the bounds to contain the box between minimum and maximum. An empty box (minimum > maximum) changes nothing
+		void growBounds(const Ogre::Vector3& minimum, const Ogre::Vector3& maximum);
+
+		///Remove the vertices from firstVertex on that no index from firstIndex on uses, and recompute the bounds.
+		///Lower LODs share the vertex buffer of the full mesh, but only use part of it
+		void removeUnreferencedVertices(size_t firstVertex, size_t firstIndex);
+
+		///Report the memory of the buffers to mMemory, after they grew or shrank
+		void updateMemory();
+
+		///Count a created shape in the memory statistics, and return it
+		template<typename T> T* recordShape(T* shape) const
+		{
+			if (shape)
+				mMemory.addShape(MemoryStats::measureShape(shape));
+			return shape;
+		}
+
 		///Append V2 Vertex data to the vertex buffer
 		void appendV1VertexData(const Ogre::v1::VertexData *vertex_data);
 
@@ -111,6 +385,13 @@ namespace BtOgre
 			const Ogre::v1::VertexData *blended_data,
 			const Ogre::v1::Mesh::IndexMap *indexMap);
 
+		///Sort the animated vertices by bone into mBoneVertices: count them per bone, prefix-sum the counts into mBoneOffsets,
+		///then scatter the vertices. Call it once all the animated vertex data is added
+		void buildBoneLayout();
+
+		///Get the vertices of a bone, a span of mBoneVertices. False if the bone has none
+		bool getBoneVertices(unsigned bone, const Ogre::Vector3*& vertices, size_t& count) const;
+
 		///Load the index data using the given type (16 or 32bit) from a v1 hardwareIndexBuffer
 		template<typename T> void loadV1IndexBuffer(Ogre::v1::HardwareIndexBufferSharedPtr ibuf, const size_t& offset,
 			const size_t& previousSize, const size_t& appendedIndexes)
@@ -128,30 +409,74 @@ namespace BtOgre
 
 		//V2 Mesh buffer loading inspired by the solution here: http://www.ogre3d.org/forums/viewtopic.php?f=25&p=522494#p522494
 
-		///Go through the submeshes and set the size of the {vertex;index} buffers
-		void getV2MeshBufferSize(const Ogre::Mesh* mesh, size_t& previousVertexSize, size_t& previousIndexSize);
+		///Everything needed to decode a submesh once its data is mapped, and where to write it
+		struct V2SubMeshReadback
+		{
+			///VAO the data is read from
+			Ogre::VertexArrayObject* vao;
+
+			///Vertex position read request. Its data pointer is valid while the tickets are mapped
+			Ogre::OGRE_VertexArrayObject_ReadRequests requests;
+
+			///Index buffer of the VAO, can be null
+			Ogre::IndexBufferPacked* indexBuffer;
+
+			///Ticket for the index data
+			Ogre::AsyncTicketPtr indexTicket;
+
+			///Mapped index data, nullptr if there's none
+			const void* indexData;
+
+			///Indices are 32 bits, otherwise 16
+			bool indices32;
+
+			///Number of vertices in the submesh
+			size_t vertexCount;
+
+			///Number of indices in the submesh
+			size_t indexCount;
+
+			///First vertex of the submesh in mVertexBuffer. Also the value added to its indices
+			size_t vertexDestination;
+
+			///First index of the submesh in mIndexBuffer
+			size_t indexDestination;
+
+			///Bounds of the decoded vertices, set by decodeV2SubMesh()
+			Ogre::Vector3 minimum, maximum;
+		};
+
+		///Grow the {vertex;index} buffers to fit the mesh, give a slice of them to each submesh and send all the read requests,
+		///so the GPU to CPU transfers happen together. Map them with mapV2SubMeshes()
+		void requestV2SubMeshes(const Ogre::Mesh* mesh, std::vector<V2SubMeshReadback>& subMeshes, unsigned short lodLevel = 0);
+
+		///Check if all the transfers of the submeshes are done, so mapping them won't stall
+		static bool isV2ReadbackDone(const std::vector<V2SubMeshReadback>& subMeshes);
 
-		///load the request and sends it to the VAO manager, this will map all tickets regarding that request, you will need to unmap them when you have finished
-		static void requestV2VertexBufferFromVao(Ogre::VertexArrayObject* vao, Ogre::OGRE_VertexArrayObject_ReadRequests& requests);
+		///Map all the tickets of the submeshes. Call releaseV2SubMeshes() when done
+		static void mapV2SubMeshes(std::vector<V2SubMeshReadback>& subMeshes);
 
-		///Load the vertex buffer data
-		void extractV2SubMeshVertexBuffer(size_t& subMeshOffset, Ogre::OGRE_VertexArrayObject_ReadRequests requests, const size_t& prevSize);
+		///Decode the mapped vertex and index data of a submesh into its slice of the buffers and compute its bounds.
+		///Only touches that slice and the submesh, safe to call in parallel. The bounds are merged by the caller
+		void decodeV2SubMesh(V2SubMeshReadback& subMesh);
 
-		///Load the index buffer data using the given type (16 or 32bit) from a V2 VAO index async ticket
-		template<typename T> void loadV2IndexBuffer(Ogre::AsyncTicketPtr asyncTicket, const size_t& offset,
-			const size_t& perviousSize, const size_t& appendedIndexes)
+		///Unmap all the tickets of the submeshes
+		static void releaseV2SubMeshes(std::vector<V2SubMeshReadback>& subMeshes);
+
+		///Decode the vertex positions of a read request to the given position in the vertex buffer, growing minimum and maximum around them
+		void extractV2SubMeshVertexBuffer(size_t destination, const Ogre::VertexArrayObject::ReadRequests& request,
+			Ogre::Vector3& minimum, Ogre::Vector3& maximum);
+
+		///Copy index data using the given type (16 or 32bit) to the index buffer, adding offset to each index
+		template<typename T> void loadV2IndexBuffer(const T* pointerData, size_t offset,
+			size_t destination, size_t appendedIndexes)
 		{
-			auto pointerData = static_cast<const T*>(asyncTicket->map());
-			for (auto i = 0; i < appendedIndexes; ++i)
+			for (size_t i = 0; i < appendedIndexes; ++i)
 			{
-				mIndexBuffer[perviousSize + i] = static_cast<unsigned>(offset + pointerData[i]);
+				mIndexBuffer[destination + i] = static_cast<unsigned>(offset + pointerData[i]);
 			}
-			asyncTicket->unmap();
 		}
 
-		///Load the index buffer data
-		void extractV2SubMeshIndexBuffer(const size_t& previousSize, const size_t& offset, const bool& indices32, Ogre::IndexBufferPacked* indexBuffer);
-
 	protected:
 
 		///Vertex buffer of the object being processed
@@ -160,22 +485,38 @@ namespace BtOgre
 		///Index buffer fo the object being processed
 		IndexBuffer		mIndexBuffer;
 
-		///Bounds of the object as a AABB min/max box
-		Ogre::Vector3	mBounds;
-		
-		///Offset of AABB center from (0,0,0) point in mesh
-		Ogre::Vector3	mCenter;
+		///Lower corner of the AABB of the vertex buffer. Greater than mBoundsMaximum while the buffer is empty
+		Ogre::Vector3	mBoundsMinimum;
+
+		///Upper corner of the AABB of the vertex buffer
+		Ogre::Vector3	mBoundsMaximum;
 
-		///Radius of a sphere that cointains the object bouns
-		Ogre::Real		mBoundRadius;
+		///Bone of each vertex of mVertexBuffer, noBone for the vertices that aren't animated
+		std::vector<uint16_t>	mVertexBones;
 
-		BoneIndex*		mBoneIndex;
+		///Animated vertices sorted by bone. The vertices of bone b are [mBoneOffsets[b], mBoneOffsets[b + 1])
+		VertexBuffer	mBoneVertices;
+
+		///Start of the vertices of each bone in mBoneVertices, one more entry than bones
+		std::vector<size_t>	mBoneOffsets;
+
+		///AABB of the vertices of each bone
+		BoneBounds		mBoneBounds;
+
+		///Bone of the vertices that aren't animated in mVertexBones
+		static const uint16_t noBone = 0xFFFF;
 
 		///Transform to apply to every point of the vertex buffer
 		Ogre::Matrix4	mTransform;
 
 		///Scale vector eventually extracted from a parent nodeS
 		Ogre::Vector3	mScale;
+
+		///Pool used to process submeshes in parallel, nullptr to do everything on the calling thread
+		ThreadPool*		mThreadPool;
+
+		///Memory counters, reported to MemoryStats. Const functions create shapes too
+		mutable detail::ConverterMemory	mMemory;
 	};
 
 	///Shape converter for static (non-animated) meshes.
@@ -186,13 +527,13 @@ namespace BtOgre
 		StaticMeshToShapeConverter(Ogre::Renderable *rend, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
 
 		///Creaate a messh converter from am V1 entity object
-		StaticMeshToShapeConverter(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+		StaticMeshToShapeConverter(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
 
 		///Create a mesh converter from a V1 mesh object
-		StaticMeshToShapeConverter(Ogre::v1::Mesh *mesh, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+		StaticMeshToShapeConverter(Ogre::v1::Mesh *mesh, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
 
 		///Create a mesh converter from a V2 Item object
-		StaticMeshToShapeConverter(Ogre::Item* item, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+		StaticMeshToShapeConverter(Ogre::Item* item, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
 
 		///Default constructor; You can add a mesh/entity later
 		StaticMeshToShapeConverter();
@@ -200,20 +541,55 @@ namespace BtOgre
 		///Default polymorphic destructor
 		virtual ~StaticMeshToShapeConverter() = default;
 
+		StaticMeshToShapeConverter(const StaticMeshToShapeConverter&) = default;
+		StaticMeshToShapeConverter(StaticMeshToShapeConverter&&) = default;
+		StaticMeshToShapeConverter& operator=(const StaticMeshToShapeConverter&) = default;
+		StaticMeshToShapeConverter& operator=(StaticMeshToShapeConverter&&) = default;
+
 		///Load an Ogre v1 entity
-		void addEntity(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+		void addEntity(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
 
-		///Load an Ogre v1 Mesh
-		void addMesh(const Ogre::v1::Mesh *mesh, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+		///Load an Ogre v1 Mesh. Lower LODs only keep the vertices their triangles use
+		void addMesh(const Ogre::v1::Mesh *mesh, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
 
 		///Load an Ogre v2 Item
-		void addItem(Ogre::Item* item, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
+		void addItem(Ogre::Item* item, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
+
+		///Load an Ogre v2 Mesh. Lower LODs only keep the vertices their triangles use
+		void addMesh(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
+
+		///addItem() in steps, to keep the GPU readback off the critical path. See requestMesh()
+		void requestItem(Ogre::Item* item, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
+
+		///addMesh() in steps, to keep the GPU readback off the critical path. requestMesh() sends the read requests,
+		///mapReadback() maps them (without stalling once isReadbackDone()), decodeReadback() fills the buffers and
+		///releaseReadback() unmaps them. decodeReadback() can run on any thread, the others must run on the render thread.
+		///Only one mesh can be in flight at a time
+		void requestMesh(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY, const MeshLod& lod = MeshLod());
+
+		///Check if the transfers sent by requestMesh() are done
+		bool isReadbackDone() const;
+
+		///Map the data read back from the GPU. Stalls until the transfers are done
+		void mapReadback();
 
-		///Load an Ogre v2 Mesh
-		void addMesh(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
+		///Decode the mapped data to the buffers
+		void decodeReadback();
+
+		///Unmap the data read back from the GPU and free the tickets. Safe after a mapReadback() that threw, only what was mapped is unmapped
+		void releaseReadback();
 
 	protected:
 
+		///Submeshes of the mesh being read back by requestMesh()
+		std::vector<V2SubMeshReadback> mReadback;
+
+		///LOD level being read back
+		unsigned short mReadbackLevel;
+
+		///Size of the {vertex;index} buffers before the mesh being read back
+		size_t mReadbackFirstVertex, mReadbackFirstIndex;
+
 		///Stored Entity
 		Ogre::v1::Entity*		mEntity;
 
@@ -224,34 +600,57 @@ namespace BtOgre
 		Ogre::SceneNode*		mNode;
 	};
 
-	///For animated meshes.
+	///For animated meshes. addEntity() takes a snapshot of the current pose, see SkinnedCollisionMesh for a mesh following the animation
 	class AnimatedMeshToShapeConverter : public VertexIndexToShape
 	{
 	public:
 
 		AnimatedMeshToShapeConverter(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
 		AnimatedMeshToShapeConverter();
-		virtual ~AnimatedMeshToShapeConverter();
+		virtual ~AnimatedMeshToShapeConverter() = default;
+
+		AnimatedMeshToShapeConverter(const AnimatedMeshToShapeConverter&) = default;
+		AnimatedMeshToShapeConverter(AnimatedMeshToShapeConverter&&) = default;
+		AnimatedMeshToShapeConverter& operator=(const AnimatedMeshToShapeConverter&) = default;
+		AnimatedMeshToShapeConverter& operator=(AnimatedMeshToShapeConverter&&) = default;
 
 		void addEntity(Ogre::v1::Entity *entity, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
 		void addMesh(const Ogre::v1::MeshPtr &mesh, const Ogre::Matrix4 &transform);
 
-		btBoxShape* createAlignedBox(unsigned char bone,
+		btBoxShape* createAlignedBox(unsigned short bone,
 			const Ogre::Vector3 &bonePosition,
 			const Ogre::Quaternion &boneOrientation);
 
-		btBoxShape* createOrientedBox(unsigned char bone,
+		///Box along the axes of the bone. If transform isn't null, it receives where the box goes, and the box is tight around the
+		///bone's vertices. Without transform, the box keeps its historical size: twice the extents of the vertices, as half extents
+		btBoxShape* createOrientedBox(unsigned short bone,
 			const Ogre::Vector3 &bonePosition,
-			const Ogre::Quaternion &boneOrientation);
+			const Ogre::Quaternion &boneOrientation,
+			btTransform* transform = nullptr);
+
+		using VertexIndexToShape::createFittedBox;
+
+		///Return a box of close to minimum volume around the vertices of a bone, and where to place it. nullptr if the bone has no vertex
+		btBoxShape* createFittedBox(unsigned short bone, btTransform& transform) const;
+
+		///Fit a primitive to every bone weighting vertices of the mesh, in the frame of the bone in the pose the vertices were read in:
+		///the entity's current pose after addEntity(), the binding pose after addMesh().
+		///Bones are fitted in parallel on the thread pool. Only reads the converter, it can run on a worker thread
+		std::vector<BoneShape> createBoneShapes(const SkeletonShapeSettings& settings = SkeletonShapeSettings()) const;
+
+		///Compound of the bone shapes, placed where the bones are in the pose the vertices were read in. The user index of each child shape is
+		///the handle of its bone, for ragdolls and hit detection. Like the other compounds, it doesn't own its children
+		btCompoundShape* createSkeletonShape(const SkeletonShapeSettings& settings = SkeletonShapeSettings()) const;
 
 	protected:
 
-		bool getBoneVertices(unsigned char bone,
-			unsigned int &vertex_count,
-			Ogre::Vector3* &vertices,
-			const Ogre::Vector3 &bonePosition);
+		///Read the pose of every bone: the current pose of the entity's skeleton, or the binding pose without entity
+		void readBonePoses(Ogre::v1::Entity* entity);
+
+		///Get the transform of a bone in the pose the vertices were read in, in the space of the vertex buffer
+		void getBonePose(unsigned short bone, Ogre::Vector3& position, Ogre::Quaternion& orientation) const;
 
-		bool getOrientedBox(unsigned char bone,
+		bool getOrientedBox(unsigned short bone,
 			const Ogre::Vector3 &bonePosition,
 			const Ogre::Quaternion &boneOrientation,
 			Ogre::Vector3 &extents,
@@ -261,7 +660,13 @@ namespace BtOgre
 		Ogre::v1::Entity*		mEntity;
 		Ogre::SceneNode*	mNode;
 
-		Ogre::Vector3       *mTransformedVerticesTemp;
-		size_t               mTransformedVerticesTempSize;
+		///Skeleton of the mesh the vertices come from
+		Ogre::v1::SkeletonPtr	mSkeleton;
+
+		///Position and orientation of each bone in the pose the vertices were read in, in the space of the mesh
+		std::vector<std::pair<Ogre::Vector3, Ogre::Quaternion>>	mBonePoses;
 	};
 }
+
+//Ogre version check and the rest of the library. Included last, the other headers need the declarations above
+#include "BtOgre.hpp"
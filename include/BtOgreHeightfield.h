@@ -0,0 +1,89 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreHeightfield.h
+ *
+ *    Description:  Heightfield shapes for terrain, from raw heightmaps or from meshes
+ *                  that are regular grids.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Regular grid of height samples. Sample (x, z) is heights[z * width + x], at corner + (x * spacing.x, height * spacing.y, z * spacing.z)
+	struct HeightfieldGrid
+	{
+		std::vector<float> heights;
+		int width;
+		int length;
+		Ogre::Vector3 spacing;
+		Ogre::Vector3 corner;
+
+		///Quads are split along the (x, z)-(x+1, z+1) diagonal instead of the (x+1, z)-(x, z+1) one
+		bool flipQuadEdges;
+	};
+
+	namespace detail
+	{
+		///Holds the samples, so they're constructed before the shape that points to them
+		struct HeightStorage
+		{
+			explicit HeightStorage(std::vector<float>&& heights);
+			std::vector<float> mHeights;
+		};
+	}
+
+	///Heightfield shape that owns its height samples
+	class OwningHeightfieldTerrainShape : private detail::HeightStorage, public btHeightfieldTerrainShape
+	{
+	public:
+		///Take the samples of the grid. minHeight and maxHeight must bound them
+		OwningHeightfieldTerrainShape(std::vector<float>&& heights, int width, int length,
+			float minHeight, float maxHeight, bool flipQuadEdges = false);
+
+		///Get the height samples
+		const std::vector<float>& getHeights() const { return mHeights; }
+	};
+
+	///Create heightfield shapes. Bullet centers a heightfield on its bounding box: the shape has to be placed at the origin
+	///offset returned by these functions (in the space of the samples) for the samples to end up where they belong
+	struct Heightfield
+	{
+		///Do not permit to construct a "BtOgre::Heightfield" object
+		Heightfield() = delete;
+
+		///Create a heightfield that references the samples. They aren't copied: keep them alive, and unchanged, as long as the shape lives
+		/// \param heights width * length samples, row after row along z
+		/// \param spacing Distance between samples along x and z, and height multiplier in y
+		/// \param corner Position of the first sample at height 0
+		static btHeightfieldTerrainShape* create(const float* heights, int width, int length,
+			const Ogre::Vector3& spacing, const Ogre::Vector3& corner, Ogre::Vector3& originOffset, bool flipQuadEdges = false);
+
+		///Create a heightfield that owns the samples of the grid
+		static OwningHeightfieldTerrainShape* create(HeightfieldGrid&& grid, Ogre::Vector3& originOffset);
+
+		///Check if the triangles are a regular grid in the XZ plane with one height per sample, and get that grid.
+		///Duplicated vertices (at UV seams...) are fine. Holes, overhangs, triangles spanning several cells or overlapping, and cells
+		///split along different diagonals aren't: every cell must be two triangles sharing the same diagonal as all the others
+		/// \param tolerance Distance under which positions are the same, relative to the grid extent
+		static bool detectGrid(const Ogre::Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+			HeightfieldGrid& grid, Ogre::Real tolerance = 1e-4f);
+
+		///Get where a heightfield over these samples has to be placed
+		static Ogre::Vector3 getOriginOffset(int width, int length, float minHeight, float maxHeight,
+			const Ogre::Vector3& spacing, const Ogre::Vector3& corner);
+	};
+}
@@ -0,0 +1,140 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreMemoryStats.h
+ *
+ *    Description:  Memory used by the converters and by the shapes they create.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <btBulletDynamicsCommon.h>
+
+namespace BtOgre
+{
+	///Memory used by a collision shape, in bytes
+	struct ShapeMemory
+	{
+		///The shape objects themselves, and the children of compounds
+		size_t shape;
+
+		///Vertices, indices, hull points and height samples, the polyhedral features of convex shapes that have them, and the
+		///triangle info map of trimeshes (estimated from its entries, Bullet doesn't expose its capacity)
+		size_t meshData;
+
+		///BVH nodes and subtree headers, and the AABB tree of compounds
+		size_t bvh;
+
+		///Get the sum of the parts
+		size_t getTotal() const { return shape + meshData + bvh; }
+	};
+
+	///Memory of a converter, in bytes. Buffers count their capacity, that's what is allocated
+	struct ConverterMemoryStats
+	{
+		///Vertex buffer
+		size_t vertexBuffer;
+
+		///Index buffer
+		size_t indexBuffer;
+
+		///Bone of each vertex, vertices sorted by bone, and their offsets and bounds
+		size_t boneLayout;
+
+		///Highest memory of the buffers since the converter was created, or since its peak was reset
+		size_t peak;
+
+		///Number of shapes created by the converter
+		size_t shapeCount;
+
+		///Memory used by these shapes when they were created. Shapes taking the buffers (like owning trimeshes) count them here
+		size_t shapeMemory;
+
+		///Get the memory of the buffers
+		size_t getBufferMemory() const { return vertexBuffer + indexBuffer + boneLayout; }
+	};
+
+	///Process-wide memory counters of BtOgre, to set memory budgets, for example when streaming levels.
+	///Converters report their buffers as they grow and shrink, and every shape they create. Functions are thread safe
+	struct MemoryStats
+	{
+		///Do not permit to construct a "BtOgre::MemoryStats" object
+		MemoryStats() = delete;
+
+		///Measure the memory used by a shape, including its mesh data and BVH. Compounds add their children unless includeChildren is false
+		static ShapeMemory measureShape(const btCollisionShape* shape, bool includeChildren = true);
+
+		///Measure the nodes and subtree headers of the BVH of a triangle mesh with this many triangles. 0 if there's no BVH
+		static size_t measureBvh(const btOptimizedBvh* bvh, size_t triangles);
+
+		///Get the memory held right now by the buffers of every converter
+		static size_t getConverterMemory();
+
+		///Get the highest memory held by the buffers of every converter at once
+		static size_t getConverterPeak();
+
+		///Start measuring the peak from the memory held right now
+		static void resetConverterPeak();
+
+		///Get the number of shapes the converters created
+		static size_t getCreatedShapeCount();
+
+		///Get the memory used by the shapes the converters created, when they were created. Deleting a shape doesn't change it
+		static size_t getCreatedShapeMemory();
+
+		///Set the created shape counters back to 0
+		static void resetCreatedShapes();
+	};
+
+	namespace detail
+	{
+		///Memory counters of one converter. Changes are reported to MemoryStats
+		class ConverterMemory
+		{
+		public:
+			ConverterMemory();
+
+			///The copy holds its own copy of the buffers, they're counted again. It didn't create any shape
+			ConverterMemory(const ConverterMemory& other);
+
+			///The buffers are replaced by a copy of the other ones. The shape counters stay
+			ConverterMemory& operator=(const ConverterMemory& other);
+
+			///The buffers were moved here: their memory, and the shapes created with them, aren't counted in the other anymore
+			ConverterMemory(ConverterMemory&& other);
+
+			///The buffers are replaced by the other ones, moved here: they stop being counted in the other. The shape counters stay
+			ConverterMemory& operator=(ConverterMemory&& other);
+
+			///The buffers are freed
+			~ConverterMemory();
+
+			///Set the memory held by the buffers now
+			void setBufferMemory(size_t bytes);
+
+			///Count a created shape
+			void addShape(const ShapeMemory& memory);
+
+			///Start measuring the peak from the memory held now
+			void resetPeak();
+
+			size_t getPeak() const { return mPeak; }
+			size_t getShapeCount() const { return mShapeCount; }
+			size_t getShapeMemory() const { return mShapeMemory; }
+
+		private:
+			size_t mBufferMemory;
+			size_t mPeak;
+			size_t mShapeCount;
+			size_t mShapeMemory;
+		};
+	}
+}
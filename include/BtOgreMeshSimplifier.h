@@ -0,0 +1,65 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreMeshSimplifier.h
+ *
+ *    Description:  Quadric error edge collapse simplification of the triangle meshes
+ *                  extracted for collision.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Vertex and triangle counts before and after a MeshSimplifier run, and the error it reached
+	struct SimplifyStatistics
+	{
+		size_t verticesBefore;
+		size_t verticesAfter;
+		size_t trianglesBefore;
+		size_t trianglesAfter;
+
+		///Largest distance to the original surface a collapse introduced (root mean square over the planes of the triangles it merged)
+		Ogre::Real error;
+	};
+
+	///Garland-Heckbert quadric edge collapse. The cheapest edge is collapsed to the point that minimizes the sum of the squared
+	///distances to the planes of the triangles around it, until the triangle target or the error bound is reached.
+	///Collapses that would flip a triangle or make the mesh non manifold are skipped, which keeps silhouettes.
+	///Border edges (used by one triangle) get heavily weighted planes so the outline of open meshes doesn't move.
+	///Positions must be shared by the triangles that touch them, weld the vertices first (seams would be kept as borders)
+	class MeshSimplifier
+	{
+	public:
+		///Stop at targetTriangles triangles, or before a collapse would move the surface by more than maxError
+		explicit MeshSimplifier(size_t targetTriangles = 0, Ogre::Real maxError = std::numeric_limits<Ogre::Real>::max());
+
+		///Set the triangle count to reach
+		void setTargetTriangles(size_t targetTriangles);
+
+		///Set the largest distance to the original surface a collapse may introduce
+		void setMaxError(Ogre::Real maxError);
+
+		///Set if the borders of open meshes are kept in place. Default is true
+		void setPreserveBorders(bool preserveBorders);
+
+		///Simplify the mesh in place. Unused vertices are removed
+		SimplifyStatistics simplify(std::vector<Ogre::Vector3>& vertices, std::vector<unsigned>& indices) const;
+
+	private:
+		size_t mTargetTriangles;
+		Ogre::Real mMaxError;
+		bool mPreserveBorders;
+	};
+}
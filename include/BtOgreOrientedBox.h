@@ -0,0 +1,54 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreOrientedBox.h
+ *
+ *    Description:  Tight oriented bounding boxes for point clouds.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreQuaternion.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///A box of any orientation
+	struct OrientedBox
+	{
+		Ogre::Vector3 center;
+		Ogre::Quaternion orientation;
+		Ogre::Vector3 halfExtents;
+
+		///Get the volume of the box
+		Ogre::Real getVolume() const;
+
+		///Get the transform placing a shape from createShape() on the box
+		btTransform getTransform() const;
+
+		///Create a box shape of the size of the box, centered on the origin. Place it with getTransform()
+		btBoxShape* createShape() const;
+	};
+
+	///Fit boxes of close to minimum volume around point clouds. The axes start from the principal components of the convex hull
+	///of the points. Then, for each axis, the points are projected on the plane of the two other axes, and the smallest rectangle
+	///around them is found by trying every edge of their 2D hull, as rotating calipers would. The best box is refined the same way.
+	///Projections and extents use VertexKernels. Functions only read the points, they can be called from several threads
+	struct OrientedBoxFitter
+	{
+		OrientedBoxFitter() = delete;
+
+		///Fit a box around the points. A single point gives an empty box on it
+		static OrientedBox fit(const Ogre::Vector3* points, size_t count);
+
+		///Get the box of this orientation around the points
+		static OrientedBox fitAxes(const Ogre::Vector3* points, size_t count, const Ogre::Quaternion& orientation);
+	};
+}
@@ -0,0 +1,176 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreQuantizedMesh.h
+ *
+ *    Description:  Triangle meshes with 16 bits positions, quantized in chunks, for
+ *                  large static worlds.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Triangle mesh split in spatially coherent chunks, each storing its vertices as 3 16 bits integers relative to the chunk's origin,
+	///and its indices in 16 bits. Positions are dequantized when a triangle is read.
+	///Every chunk uses the same grid: its step fits the largest chunk in 16 bits, and origins are on grid points. A vertex shared by
+	///several chunks decodes to the same position in each of them, so there are no cracks between chunks. Small chunks don't get a
+	///better precision than the largest one.
+	///The vertex type reported by getLockedReadOnlyVertexIndexBase() is PHY_SHORT: Bullet code that reads the vertices directly instead of
+	///going through InternalProcessAllTriangles() (btBvhTriangleMeshShape, btGenerateInternalEdgeInfo, serialization) can't use it.
+	///Use it through QuantizedBvhTriangleMeshShape
+	class QuantizedMeshInterface : public btStridingMeshInterface
+	{
+	public:
+		///Quantize the mesh. Triangles are sorted along a Morton curve and grouped in chunks of at most maxChunkTriangles triangles,
+		///and at most 65536 vertices, the reach of their 16 bits indices. The grid is shared by every chunk, with a step fitting the
+		///largest chunk in 16 bits: smaller chunks give a finer grid for the whole mesh
+		QuantizedMeshInterface(const Ogre::Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+			unsigned maxChunkTriangles = 4096);
+
+		///Get the dequantized, scaled, corners of a triangle
+		void getTriangle(int chunk, int triangle, btVector3* corners) const;
+
+		///Get the largest distance between an original vertex and its dequantized position, before scaling
+		Ogre::Real getMaxError() const { return mMaxError; }
+
+		///Get the number of vertices stored. Vertices shared by several chunks are stored once per chunk
+		size_t getVertexCount() const { return mPositions.size() / 3; }
+
+		///Get the number of triangles stored
+		size_t getTriangleCount() const { return mIndices.size() / 3; }
+
+		///Get the memory used by the positions, indices and chunk descriptions, in bytes
+		size_t getMemoryUsage() const;
+
+		void InternalProcessAllTriangles(btInternalTriangleIndexCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const override;
+
+		void getLockedVertexIndexBase(unsigned char** vertexBase, int& vertexCount, PHY_ScalarType& type, int& stride,
+			unsigned char** indexBase, int& indexStride, int& faceCount, PHY_ScalarType& indexType, int subpart = 0) override;
+
+		void getLockedReadOnlyVertexIndexBase(const unsigned char** vertexBase, int& vertexCount, PHY_ScalarType& type, int& stride,
+			const unsigned char** indexBase, int& indexStride, int& faceCount, PHY_ScalarType& indexType, int subpart = 0) const override;
+
+		void unLockVertexBase(int) override {}
+		void unLockReadOnlyVertexBase(int) const override {}
+		int getNumSubParts() const override { return int(mChunks.size()); }
+		void preallocateVertices(int) override {}
+		void preallocateIndices(int) override {}
+
+		///The bounding box is known from the chunks, no need to go through all the triangles
+		bool hasPremadeAabb() const override { return true; }
+		void setPremadeAabb(const btVector3&, const btVector3&) const override {}
+		void getPremadeAabb(btVector3* aabbMin, btVector3* aabbMax) const override;
+
+	private:
+		///A range of the position and index arrays, with the grid point the positions are relative to
+		struct Chunk
+		{
+			size_t firstVertex;
+			unsigned vertexCount;
+			size_t firstIndex;
+			unsigned triangleCount;
+			uint32_t origin[3];
+			uint16_t size[3];
+		};
+
+		///Get the unscaled position of a grid point
+		btVector3 dequantize(const Chunk& chunk, const uint16_t* quantized) const;
+
+		///Get the scaled bounding box of a chunk
+		void getChunkAabb(const Chunk& chunk, btVector3& aabbMin, btVector3& aabbMax) const;
+
+		///Position of the grid point 0, and distance between grid points, shared by every chunk
+		Ogre::Vector3 mMinimum;
+		Ogre::Vector3 mStep;
+
+		std::vector<Chunk> mChunks;
+		std::vector<uint16_t> mPositions;
+		std::vector<uint16_t> mIndices;
+		Ogre::Real mMaxError;
+	};
+
+	namespace detail
+	{
+		///Storage for QuantizedBvhTriangleMeshShape. Declared as the first base so it is constructed before the Bullet shape that points into it
+		struct QuantizedMeshStorage
+		{
+			QuantizedMeshStorage(const Ogre::Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+				unsigned maxChunkTriangles, const btVector3& scaling);
+
+			QuantizedMeshInterface mQuantizedMesh;
+		};
+	}
+
+	///Static triangle mesh shape over a QuantizedMeshInterface, with its own BVH. Queries dequantize only the triangles the BVH reports.
+	///Its shape type is CUSTOM_CONCAVE_SHAPE_TYPE: the collision world handles it like any concave shape, through processAllTriangles()
+	class QuantizedBvhTriangleMeshShape : private detail::QuantizedMeshStorage, public btTriangleMeshShape
+	{
+	public:
+		///Quantize the mesh and build the BVH. The scaling is applied before the BVH is built, so it's only built once
+		QuantizedBvhTriangleMeshShape(const Ogre::Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+			const btVector3& scaling = btVector3(1, 1, 1), unsigned maxChunkTriangles = 4096);
+
+		///Free the BVH
+		virtual ~QuantizedBvhTriangleMeshShape();
+
+		void processAllTriangles(btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const override;
+
+		///Report the triangles whose BVH node the ray crosses
+		void performRaycast(btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget) const;
+
+		///Report the triangles whose BVH node the box crosses when swept from boxSource to boxTarget
+		void performConvexcast(btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget,
+			const btVector3& boxMin, const btVector3& boxMax) const;
+
+		///Change the scaling. The BVH is rebuilt
+		void setLocalScaling(const btVector3& scaling) override;
+
+		const char* getName() const override { return "QuantizedBvhTriangleMesh"; }
+
+		///Get the quantized mesh
+		const QuantizedMeshInterface& getQuantizedMesh() const { return mQuantizedMesh; }
+
+		///Get the BVH
+		const btOptimizedBvh* getOptimizedBvh() const { return mBvh; }
+
+		///Get the memory used by the shape, its mesh and its BVH, in bytes
+		size_t getMemoryUsage() const;
+
+	private:
+		///(Re)build the BVH over the scaled triangles
+		void buildBvh();
+
+		btOptimizedBvh* mBvh;
+	};
+
+	///Throughput of the triangle queries a concave shape answers
+	struct QueryThroughput
+	{
+		double queriesPerSecond;
+		double trianglesPerQuery;
+	};
+
+	///Measure how fast shapes answer box queries, like the ones contact generation does. Used to compare the quantized and the float path
+	struct QueryBenchmark
+	{
+		///Do not permit to construct a "BtOgre::QueryBenchmark" object
+		QueryBenchmark() = delete;
+
+		///Run queryCount queries with cubes of querySize times the shape's bounding box diagonal, spread uniformly in that box.
+		///The same seed gives the same boxes, so different shapes of the same mesh can be compared
+		static QueryThroughput measure(const btConcaveShape* shape, size_t queryCount = 10000, Ogre::Real querySize = 0.01f, unsigned seed = 0);
+	};
+}
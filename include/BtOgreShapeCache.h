@@ -0,0 +1,167 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreShapeCache.h
+ *
+ *    Description:  Process-wide cache of collision shapes, shared between every object
+ *                  that uses the same mesh.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "BtOgreGP.h"
+
+namespace BtOgre
+{
+	///A collision shape that can be shared. It is freed when the cache and every user released it
+	using SharedShape = std::shared_ptr<btCollisionShape>;
+
+	///Cache of collision shapes keyed by mesh name, shape kind and transform.
+	///Shapes are built once, without scale. Scaled instances get a light wrapper around the cached shape.
+	///Least recently used shapes are dropped from the cache when it goes over its memory budget.
+	class ShapeCache
+	{
+	public:
+		///Create a cache. A budget of 0 means unlimited
+		explicit ShapeCache(size_t memoryBudget = 0);
+
+		///Release the references held by the cache. Shapes still in use are kept alive by their users
+		~ShapeCache() = default;
+
+		///Get the process-wide cache
+		static ShapeCache& getSingleton();
+
+		///Get a shape for the mesh of this item, scaled by the item's parent node
+		SharedShape getShape(Ogre::Item* item, ShapeKind kind, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
+
+		///Get a shape for this v2 mesh with the given scale
+		SharedShape getShape(const Ogre::Mesh* mesh, ShapeKind kind, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY,
+			const Ogre::Vector3& scale = Ogre::Vector3::UNIT_SCALE);
+
+		///Get a shape for the mesh of this v1 entity, scaled by the entity's parent node
+		SharedShape getShape(Ogre::v1::Entity* entity, ShapeKind kind, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
+
+		///Get a shape for this v1 mesh with the given scale
+		SharedShape getShape(const Ogre::v1::Mesh* mesh, ShapeKind kind, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY,
+			const Ogre::Vector3& scale = Ogre::Vector3::UNIT_SCALE);
+
+		///Get the bone shapes of the skeleton of this v1 mesh, see AnimatedMeshToShapeConverter::createSkeletonShape.
+		///Built once per mesh and settings, then shared by every character using the mesh. The shape isn't scaled
+		SharedShape getSkeletonShape(const Ogre::v1::MeshPtr& mesh, const SkeletonShapeSettings& settings = SkeletonShapeSettings());
+
+		///Get the bone shapes of the skeleton of the mesh of this v1 entity
+		SharedShape getSkeletonShape(Ogre::v1::Entity* entity, const SkeletonShapeSettings& settings = SkeletonShapeSettings());
+
+		///Set the memory budget in bytes, evicting shapes if needed. 0 means unlimited
+		void setMemoryBudget(size_t bytes);
+
+		///Get the memory budget in bytes
+		size_t getMemoryBudget() const;
+
+		///Get the estimated memory used by the cached shapes in bytes
+		size_t getMemoryUsage() const;
+
+		///Get the number of cached shapes
+		size_t getEntryCount() const;
+
+		///Number of requests that were served from the cache
+		size_t getHitCount() const;
+
+		///Number of requests that needed to build a shape
+		size_t getMissCount() const;
+
+		///Number of shapes dropped to stay under the memory budget
+		size_t getEvictionCount() const;
+
+		///Set the hit, miss and eviction counters back to 0
+		void resetCounters();
+
+		///Drop every cached shape
+		void clear();
+
+		///Get an instance of an unscaled shape with this scale, sharing the shape's data: a btScaledBvhTriangleMeshShape around a trimesh
+		///and its BVH, a btUniformScalingShape around a convex shape, a btConvexPointCloudShape reading the points of a hull for non uniform
+		///scales, and a compound of instances of the children of a compound. Primitives are copied, they have no data to share.
+		///The instance keeps the shape alive. Memory for scattered instances grows with the number of unique shapes, not of instances,
+		///with two exceptions for non uniform scales:
+		/// - A hull with polyhedral features gives its point cloud instance its own features, which depend on the scale. This keeps
+		///   SAT contact clipping, at the cost of one btConvexPolyhedron per instance
+		/// - The rotation of a compound child doesn't commute with the scale: rotated convex children are baked in a scaled hull
+		///   (round primitives are approximated by a polygonal one). A rotated concave child can't be scaled, the shape is used unscaled
+		static SharedShape createScaledInstance(const SharedShape& shape, const Ogre::Vector3& scale);
+
+		///Estimate the memory used by a shape created by BtOgre, including its mesh data and BVH. See MemoryStats::measureShape
+		static size_t estimateShapeSize(const btCollisionShape* shape);
+
+	private:
+		///What identify a cached shape
+		struct Key
+		{
+			std::string meshName;
+			ShapeKind kind;
+			size_t transformHash;
+
+			///Settings of ShapeKind::Skeleton shapes, compared in full. Default for the other kinds
+			SkeletonShapeSettings skeletonSettings;
+
+			bool operator==(const Key& other) const;
+		};
+
+		///Hash function of a key for the index
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		///A cached, unscaled shape
+		struct Entry
+		{
+			Key key;
+			SharedShape shape;
+			size_t size;
+		};
+
+		///Entries, most recently used first
+		using EntryList = std::list<Entry>;
+
+		///Hash a transform matrix
+		static size_t hashTransform(const Ogre::Matrix4& transform);
+
+		///Get the unscaled shape from the cache, or build it with the given function and store it
+		SharedShape getUnscaledShape(const Key& key, const std::function<btCollisionShape*()>& build);
+
+		///Drop least recently used entries until the usage fits the budget. mMutex must be locked
+		void evict();
+
+		///Protect everything below
+		mutable std::mutex mMutex;
+
+		///LRU list of entries
+		EntryList mEntries;
+
+		///Index to find an entry in the list
+		std::unordered_map<Key, EntryList::iterator, KeyHash> mIndex;
+
+		///Memory budget in bytes, 0 for unlimited
+		size_t mMemoryBudget;
+
+		///Estimated memory used by the cached shapes
+		size_t mMemoryUsage;
+
+		///Statistic counters
+		size_t mHits, mMisses, mEvictions;
+	};
+}
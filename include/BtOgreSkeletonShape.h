@@ -0,0 +1,84 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreSkeletonShape.h
+ *
+ *    Description:  Hitbox and ragdoll shapes fitted to the bones of a skeleton.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Primitive fitted to the vertices of a bone, in the frame of the bone
+	enum class BonePrimitive
+	{
+		None,      ///<No shape for this bone
+		Box,       ///<Box aligned on the axes of the bone
+		Capsule,   ///<Capsule along the longest axis of the bone
+		Convex,    ///<Reduced convex hull, see ConvexHullBuilder
+		FittedBox, ///<Box of close to minimum volume in any orientation, see OrientedBoxFitter
+		Cylinder   ///<Cylinder along the longest axis of the bone
+	};
+
+	///Tuning of the shapes built for a whole skeleton
+	struct SkeletonShapeSettings
+	{
+		///Primitive of the bones that aren't in bonePrimitives
+		BonePrimitive primitive = BonePrimitive::Box;
+
+		///Primitive of some bones, by bone name
+		std::map<std::string, BonePrimitive> bonePrimitives;
+
+		///Bones weighting fewer vertices than this get no shape
+		size_t minVertices = 4;
+
+		///Grow the shapes up to the bone origin, so limbs reach their joint
+		bool includeBoneOrigin = true;
+
+		///Maximum number of vertices of the Convex hulls
+		unsigned hullVertexBudget = 16;
+
+		///Get a hash of the settings, to cache the shapes built with them
+		size_t hash() const;
+
+		///True if every setting is the same
+		bool operator==(const SkeletonShapeSettings& other) const;
+	};
+
+	///A shape fitted to a bone
+	struct BoneShape
+	{
+		///Handle of the bone in the skeleton
+		unsigned short bone;
+
+		///The shape, the caller owns it
+		btCollisionShape* shape;
+
+		///Transform of the shape in the frame of the bone. The shape follows the bone at boneTransform * offset
+		btTransform offset;
+	};
+
+	///Fit primitives to the vertices of a bone
+	struct BoneShapeFitter
+	{
+		BoneShapeFitter() = delete;
+
+		///Fit a primitive to points given in the frame of the bone, and get where it goes in that frame.
+		///nullptr for BonePrimitive::None or if the points are all at the same place
+		static btCollisionShape* fit(BonePrimitive primitive, const Ogre::Vector3* points, size_t count,
+			unsigned hullVertexBudget, btTransform& offset);
+	};
+}
@@ -0,0 +1,140 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreSkinnedMesh.h
+ *
+ *    Description:  Triangle mesh collision following the animation of a skinned entity.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BtOgreGP.h"
+
+namespace BtOgre
+{
+	///What keeps the triangles of a SkinnedCollisionMesh searchable
+	enum class SkinnedBackend
+	{
+		Bvh,    ///<btBvhTriangleMeshShape whose BVH is refit in place. For static and kinematic objects
+		GImpact ///<btGImpactMeshShape whose box tree is refit. For dynamic objects, needs btGImpactCollisionAlgorithm::registerAlgorithm()
+	};
+
+	///Work done by the last SkinnedCollisionMesh::update()
+	struct SkinnedUpdateStats
+	{
+		///Time spent skinning the vertices, in milliseconds
+		double skin;
+
+		///Time spent refitting the tree, in milliseconds
+		double refit;
+
+		///Number of vertices that moved more than the refit threshold
+		size_t movedVertices;
+
+		///True if the whole tree was refit, because the mesh left the quantization bounds of the BVH
+		bool fullRefit;
+	};
+
+	///Triangle mesh collision following the animation of a v1 entity. The binding pose, the bone weights and the triangles are read once.
+	///Each update() skins the positions with the current pose of the skeleton into a persistent buffer, on the thread pool, and refits
+	///the tree over them: the topology never changes, so nothing is rebuilt. With the Bvh backend, only the subtrees around the vertices
+	///that moved are refit while the mesh stays in the quantization bounds of the BVH.
+	///The collision world updates the AABB of active objects every step; call btCollisionWorld::updateSingleAabb() for the others
+	class SkinnedCollisionMesh
+	{
+	public:
+		///Read the entity's mesh and build the shape over its current pose.
+		/// \param boundsMargin The quantization bounds of the BVH are the AABB of the pose grown by this fraction of its size on every side
+		explicit SkinnedCollisionMesh(Ogre::v1::Entity* entity, SkinnedBackend backend = SkinnedBackend::Bvh,
+			ThreadPool* pool = &ThreadPool::getSingleton(), Ogre::Real boundsMargin = 0.5f);
+
+		///Delete the shape, then the buffers it reads
+		~SkinnedCollisionMesh() = default;
+
+		///Not copyable
+		SkinnedCollisionMesh(const SkinnedCollisionMesh&) = delete;
+
+		///Not copyable
+		SkinnedCollisionMesh& operator=(const SkinnedCollisionMesh&) = delete;
+
+		///Skin the vertices with the current pose of the entity's skeleton and refit the shape. Call it on the render thread,
+		///after the animations were advanced and before the physics step
+		void update();
+
+		///Get the shape. It stays the same object for the lifetime of the SkinnedCollisionMesh
+		btCollisionShape* getShape() const { return mShape.get(); }
+
+		///Get the backend the shape uses
+		SkinnedBackend getBackend() const { return mBackend; }
+
+		///Set the distance a vertex has to move before it's updated and its part of the tree refit. Vertices that move less keep
+		///their previous position. Default is 0, any move counts
+		void setRefitThreshold(Ogre::Real distance);
+
+		///Get the distance a vertex has to move before it's updated
+		Ogre::Real getRefitThreshold() const { return mRefitThreshold; }
+
+		///Get the work done by the last update()
+		const SkinnedUpdateStats& getLastUpdate() const { return mLastUpdate; }
+
+		///Get the skinned vertices, in the space of the mesh
+		const VertexBuffer& getVertices() const { return mVertices; }
+
+	private:
+		///The four bones moving a vertex, and their weights
+		struct Influences
+		{
+			unsigned short bones[4];
+			float weights[4];
+		};
+
+		///Append the influences of the vertices of this vertex data, in the order AnimatedMeshToShapeConverter adds them
+		void readInfluences(const Ogre::v1::VertexData* vertexData, const Ogre::v1::Mesh::IndexMap& indexMap);
+
+		///Get the bone matrices of the current pose of the skeleton
+		void readBoneMatrices();
+
+		///Set the quantization bounds of the BVH around this AABB, grown by mBoundsMargin
+		void setQuantizationBounds(const Ogre::Vector3& minimum, const Ogre::Vector3& maximum);
+
+		///Skin the vertices into mVertices. Get the AABB of the mesh, and of the old and new positions of the vertices that moved
+		size_t skin(Ogre::Vector3& minimum, Ogre::Vector3& maximum, Ogre::Vector3& movedMinimum, Ogre::Vector3& movedMaximum);
+
+		Ogre::v1::Entity* mEntity;
+		SkinnedBackend mBackend;
+		ThreadPool* mPool;
+		Ogre::Real mBoundsMargin;
+		Ogre::Real mRefitThreshold;
+
+		///Positions in the binding pose, in the space of the mesh
+		VertexBuffer mBindingPose;
+
+		///Bones moving each vertex
+		std::vector<Influences> mInfluences;
+
+		///Skinned positions, read by the shape
+		VertexBuffer mVertices;
+
+		///Triangles, read by the shape
+		IndexBuffer mIndices;
+
+		///Transforms of the bones from the binding pose to the current pose
+		std::vector<Ogre::Matrix4> mBoneMatrices;
+
+		///Quantization bounds of the BVH
+		Ogre::Vector3 mQuantizationMinimum, mQuantizationMaximum;
+
+		std::unique_ptr<btTriangleIndexVertexArray> mMeshInterface;
+		std::unique_ptr<btCollisionShape> mShape;
+		SkinnedUpdateStats mLastUpdate;
+	};
+}
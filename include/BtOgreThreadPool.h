@@ -0,0 +1,91 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreThreadPool.h
+ *
+ *    Description:  Small worker pool used to run the CPU heavy parts of the mesh to
+ *                  shape conversion in parallel.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+namespace BtOgre
+{
+	///Fixed set of worker threads executing tasks in FIFO order
+	class ThreadPool
+	{
+	public:
+		///Start the workers. 0 means one per hardware thread
+		explicit ThreadPool(size_t threadCount = 0);
+
+		///Finish the queued tasks and join the workers
+		~ThreadPool();
+
+		///Not copyable
+		ThreadPool(const ThreadPool&) = delete;
+
+		///Not copyable
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		///Get the pool shared by BtOgre's converters
+		static ThreadPool& getSingleton();
+
+		///Get the number of worker threads
+		size_t getThreadCount() const;
+
+		///Queue a task and get a future for its result
+		template<typename Function>
+		std::future<typename std::result_of<Function()>::type> enqueue(Function&& function)
+		{
+			using Result = typename std::result_of<Function()>::type;
+
+			//std::function needs something copyable
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+			auto future = task->get_future();
+			push([task] { (*task)(); });
+			return future;
+		}
+
+		///Call body(i) for every i in [0, count) using the workers and the calling thread. Return when all calls are done.
+		///Safe to call from a task running on this pool. The first exception thrown by body is rethrown here
+		void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	private:
+		///Add a task to the queue and wake a worker
+		void push(std::function<void()> task);
+
+		///What the worker threads run
+		void workerLoop();
+
+		///Worker threads
+		std::vector<std::thread> mWorkers;
+
+		///Tasks waiting for a worker
+		std::deque<std::function<void()>> mTasks;
+
+		///Protect mTasks and mStopping
+		std::mutex mMutex;
+
+		///Signaled when a task is queued or the pool stops
+		std::condition_variable mCondition;
+
+		///Set when the pool is destroyed
+		bool mStopping;
+	};
+}
@@ -0,0 +1,113 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreTiledTrimesh.h
+ *
+ *    Description:  Large triangle meshes split in spatial tiles, each with its own BVH,
+ *                  gathered in a compound shape.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreVector3.h>
+
+#include "BtOgreThreadPool.h"
+
+namespace BtOgre
+{
+	///Tuning of a TiledTrimeshShape
+	struct TilingSettings
+	{
+		///Size of the grid cells, in the space of the mesh (before scaling)
+		Ogre::Vector3 tileSize = Ogre::Vector3(64, 64, 64);
+
+		///Tiles with more triangles than this are split in 8, like octree nodes. 0 keeps the regular grid
+		size_t maxTileTriangles = 0;
+
+		///Number of times a grid cell can be split
+		unsigned maxDepth = 4;
+	};
+
+	///Cell (x, y, z) of the grid of cells of size tileSize / 2^depth
+	struct TileKey
+	{
+		int x;
+		int y;
+		int z;
+		unsigned depth;
+
+		bool operator==(const TileKey& other) const;
+		bool operator<(const TileKey& other) const;
+	};
+
+	///Hash of a TileKey, for unordered containers
+	struct TileKeyHash
+	{
+		size_t operator()(const TileKey& key) const;
+	};
+
+	///Compound of triangle mesh tiles, each one with its own BVH, kept in the compound's dynamic AABB tree.
+	///The broadphase sees one box for the compound, but the midphase only goes through the tiles near the query,
+	///and every BVH stays small. Tiles are built in parallel, and can be replaced one at a time.
+	///The compound owns its tiles, they are deleted with it
+	class TiledTrimeshShape : public btCompoundShape
+	{
+	public:
+		///Empty compound, whose tiles will be built with these settings and this scale
+		explicit TiledTrimeshShape(const TilingSettings& settings = TilingSettings(), const Ogre::Vector3& scale = Ogre::Vector3::UNIT_SCALE);
+
+		///Delete the tiles
+		virtual ~TiledTrimeshShape();
+
+		///Split the triangles in tiles by their centroid, build the tiles on the pool and add them. Existing tiles overlapping a new one
+		///are removed, whatever their depth: a rebuild with other settings doesn't leave the old tiles behind
+		void build(const Ogre::Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+			ThreadPool* pool = &ThreadPool::getSingleton());
+
+		///Build the shape of a tile from these triangles, relative to the tile center and scaled. It isn't added to the compound
+		btBvhTriangleMeshShape* createTile(const TileKey& key, const Ogre::Vector3* vertices, const unsigned* indices, size_t indexCount) const;
+
+		///Put this shape at the center of the tile, and delete the one that was there. nullptr just removes the tile.
+		///The compound takes ownership of the shape
+		void setTile(const TileKey& key, btCollisionShape* shape);
+
+		///Get the shape of a tile, or nullptr if there's no such tile
+		btCollisionShape* getTile(const TileKey& key) const;
+
+		///Get the keys of the tiles, in child order
+		const std::vector<TileKey>& getTileKeys() const { return mChildKeys; }
+
+		///Get the key of the tile of the given depth that contains the point, in the space of the mesh
+		TileKey getTileKey(const Ogre::Vector3& point, unsigned depth = 0) const;
+
+		///Get the center of a tile, in the space of the mesh
+		Ogre::Vector3 getTileCenter(const TileKey& key) const;
+
+		///Get the settings
+		const TilingSettings& getSettings() const { return mSettings; }
+
+	private:
+		///Build the shape of a tile from some triangles of the buffers
+		btBvhTriangleMeshShape* createTile(const TileKey& key, const Ogre::Vector3* vertices, const unsigned* indices,
+			const std::vector<unsigned>& triangles) const;
+
+		TilingSettings mSettings;
+		Ogre::Vector3 mScale;
+
+		///Child index of each tile
+		std::unordered_map<TileKey, int, TileKeyHash> mTiles;
+
+		///Tile of each child
+		std::vector<TileKey> mChildKeys;
+	};
+}
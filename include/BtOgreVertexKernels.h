@@ -0,0 +1,64 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreVertexKernels.h
+ *
+ *    Description:  Vectorized kernels that read vertex positions from a strided GPU
+ *                  buffer copy, decode them and apply the converter's transform.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <OgreMatrix4.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Position decoding kernels. The best implementation for the CPU is picked at runtime.
+	///Affine transforms give the same bits as Ogre's Matrix4 * Vector3 (no fused multiply-add is used, and the kernels are built
+	///without fast math nor contraction, see CMakeLists.txt). tests/VertexKernelsTest.cpp checks it for every instruction set.
+	///Projective transforms always use the scalar path. The identity transform is skipped entirely,
+	///the only visible difference being that -0.0 coordinates are kept as-is.
+	namespace VertexKernels
+	{
+		///Implementations available
+		enum class InstructionSet
+		{
+			Scalar,
+			SSE2,
+			AVX2,
+			NEON
+		};
+
+		///Get the best instruction set this build and this CPU support
+		InstructionSet getSupportedInstructionSet();
+
+		///Get the instruction set currently used by the kernels
+		InstructionSet getInstructionSet();
+
+		///Force the kernels to use an instruction set, to compare them or to work around a problem.
+		///An instruction set that isn't supported is replaced by the best supported one
+		void setInstructionSet(InstructionSet instructionSet);
+
+		///True if half floats are converted by the hardware (F16C or NEON) instead of Ogre::Bitwise::halfToFloat
+		bool hasHardwareHalfConversion();
+
+		///Read count VET_FLOAT3 positions stride bytes apart, transform them and write them to destination.
+		///minimum and maximum are grown to contain the written positions
+		void transformFloat3(const unsigned char* source, size_t stride, size_t count,
+			const Ogre::Matrix4& transform, Ogre::Vector3* destination, Ogre::Vector3& minimum, Ogre::Vector3& maximum);
+
+		///Read count VET_HALF4 positions stride bytes apart, convert them to float, transform them and write them to destination.
+		///minimum and maximum are grown to contain the written positions
+		void transformHalf4(const unsigned char* source, size_t stride, size_t count,
+			const Ogre::Matrix4& transform, Ogre::Vector3* destination, Ogre::Vector3& minimum, Ogre::Vector3& maximum);
+	}
+}
@@ -0,0 +1,233 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreAsyncConverter.cpp
+ *
+ *    Description:  BtOgre asynchronous mesh to shape conversion implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreAsyncConverter.h"
+#include "BtOgreInternal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+using namespace Ogre;
+using namespace BtOgre;
+using detail::log;
+
+struct AsyncConverter::Job
+{
+	///What update() does next with the job
+	enum class Stage
+	{
+		Queued,   ///<Readback to request, or v1 data to extract
+		Reading,  ///<Waiting for the GPU transfer
+		Decoding, ///<Mapped, the pool is decoding it
+		Building, ///<Unmapped, the pool is building the shape
+		Done      ///<Delivered
+	};
+
+	Item* item = nullptr;
+	v1::Entity* entity = nullptr;
+	MeshLod lod;
+	ShapeBuilder builder;
+	Callback callback;
+
+	///Result for convert() calls without a callback
+	std::promise<btCollisionShape*> promise;
+
+	StaticMeshToShapeConverter converter;
+	Stage stage = Stage::Queued;
+
+	///Set by the pool once the mapped data isn't read anymore
+	std::atomic<bool> decoded{ false };
+
+	///Result for the callback
+	btCollisionShape* shape = nullptr;
+	std::exception_ptr error;
+
+	///CPU side of the job, on the pool
+	std::future<void> task;
+};
+
+AsyncConverter::AsyncConverter(ThreadPool* pool) :
+	mPool(pool)
+{
+}
+
+AsyncConverter::~AsyncConverter()
+{
+	for (auto& job : mActive)
+	{
+		if (job->task.valid())
+			job->task.wait();
+
+		//The pool is done with it, it can be unmapped
+		if (job->stage == Job::Stage::Decoding)
+			job->converter.releaseReadback();
+	}
+}
+
+AsyncConverter::ShapeBuilder AsyncConverter::makeBuilder(ShapeKind kind)
+{
+	return [kind](StaticMeshToShapeConverter& converter) -> btCollisionShape*
+	{
+		if (kind == ShapeKind::Trimesh)
+			return converter.createOwningTrimesh();
+		return converter.createShape(kind);
+	};
+}
+
+std::future<btCollisionShape*> AsyncConverter::convert(Item* item, ShapeBuilder builder, const MeshLod& lod)
+{
+	auto job = std::make_shared<Job>();
+	job->item = item;
+	job->builder = std::move(builder);
+	job->lod = lod;
+
+	auto future = job->promise.get_future();
+	push(std::move(job));
+	return future;
+}
+
+std::future<btCollisionShape*> AsyncConverter::convert(v1::Entity* entity, ShapeBuilder builder, const MeshLod& lod)
+{
+	auto job = std::make_shared<Job>();
+	job->entity = entity;
+	job->builder = std::move(builder);
+	job->lod = lod;
+
+	auto future = job->promise.get_future();
+	push(std::move(job));
+	return future;
+}
+
+void AsyncConverter::convert(Item* item, ShapeBuilder builder, Callback callback, const MeshLod& lod)
+{
+	auto job = std::make_shared<Job>();
+	job->item = item;
+	job->builder = std::move(builder);
+	job->callback = std::move(callback);
+	job->lod = lod;
+	push(std::move(job));
+}
+
+void AsyncConverter::convert(v1::Entity* entity, ShapeBuilder builder, Callback callback, const MeshLod& lod)
+{
+	auto job = std::make_shared<Job>();
+	job->entity = entity;
+	job->builder = std::move(builder);
+	job->callback = std::move(callback);
+	job->lod = lod;
+	push(std::move(job));
+}
+
+void AsyncConverter::push(std::shared_ptr<Job> job)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mQueued.push_back(std::move(job));
+}
+
+void AsyncConverter::startBuild(const std::shared_ptr<Job>& job, bool decode)
+{
+	job->stage = decode ? Job::Stage::Decoding : Job::Stage::Building;
+
+	//mActive keeps the job alive until the task is over. Holding a shared_ptr in the task would make a cycle through job->task
+	const auto raw = job.get();
+	job->task = mPool->enqueue([raw, decode]
+	{
+		try
+		{
+			if (decode)
+				raw->converter.decodeReadback();
+			raw->decoded = true;
+
+			raw->shape = raw->builder(raw->converter);
+			if (!raw->callback)
+				raw->promise.set_value(raw->shape);
+		}
+		catch (...)
+		{
+			raw->decoded = true;
+			raw->shape = nullptr;
+			raw->error = std::current_exception();
+			if (!raw->callback)
+				raw->promise.set_exception(raw->error);
+		}
+	});
+}
+
+void AsyncConverter::update()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mActive.insert(mActive.end(), mQueued.begin(), mQueued.end());
+		mQueued.clear();
+	}
+
+	for (const auto& job : mActive)
+	{
+		if (job->stage == Job::Stage::Queued)
+		{
+			job->converter.setThreadPool(mPool);
+			if (job->item)
+			{
+				job->converter.requestItem(job->item, Matrix4::IDENTITY, job->lod);
+				job->stage = Job::Stage::Reading;
+			}
+			else
+			{
+				//v1 buffers are in system memory or locked right away, nothing to wait for
+				job->converter.addEntity(job->entity, Matrix4::IDENTITY, job->lod);
+				startBuild(job, false);
+			}
+		}
+
+		if (job->stage == Job::Stage::Reading && job->converter.isReadbackDone())
+		{
+			job->converter.mapReadback();
+			startBuild(job, true);
+		}
+
+		if (job->stage == Job::Stage::Decoding && job->decoded)
+		{
+			job->converter.releaseReadback();
+			job->stage = Job::Stage::Building;
+		}
+
+		if (job->stage == Job::Stage::Building && job->task.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			if (job->callback)
+			{
+				if (job->error)
+				{
+					try { std::rethrow_exception(job->error); }
+					catch (const std::exception& e) { log(std::string("AsyncConverter : shape build failed : ") + e.what()); }
+					catch (...) { log("AsyncConverter : shape build failed"); }
+				}
+				job->callback(job->shape);
+			}
+			job->stage = Job::Stage::Done;
+		}
+	}
+
+	mActive.erase(std::remove_if(mActive.begin(), mActive.end(), [](const std::shared_ptr<Job>& job)
+	{
+		return job->stage == Job::Stage::Done;
+	}), mActive.end());
+}
+
+size_t AsyncConverter::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mQueued.size() + mActive.size();
+}
@@ -0,0 +1,163 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreBatchConverter.cpp
+ *
+ *    Description:  BtOgre batched mesh to shape conversion implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreBatchConverter.h"
+#include "BtOgreInternal.h"
+
+using namespace Ogre;
+using namespace BtOgre;
+using detail::Clock;
+using detail::log;
+using detail::millisecondsSince;
+
+BatchConverter::BatchConverter(ThreadPool* pool) :
+	mPool(pool),
+	mTimings{ 0, 0, 0, 0 }
+{
+}
+
+void BatchConverter::add(Item* item, const Matrix4& transform, const MeshLod& lod)
+{
+	mEntries.push_back({ item, item->getMesh().get(), transform, Vector3::UNIT_SCALE, lod });
+}
+
+void BatchConverter::add(const Mesh* mesh, const Matrix4& transform, const Vector3& scale, const MeshLod& lod)
+{
+	mEntries.push_back({ nullptr, mesh, transform, scale, lod });
+}
+
+void BatchConverter::clear()
+{
+	mEntries.clear();
+}
+
+void BatchConverter::forEach(size_t count, const std::function<void(size_t)>& body)
+{
+	if (mPool)
+		mPool->parallelFor(count, body);
+	else
+		for (auto i = size_t{ 0 }; i < count; ++i) body(i);
+}
+
+std::vector<std::unique_ptr<StaticMeshToShapeConverter>> BatchConverter::read()
+{
+	mTimings = { 0, 0, 0, 0 };
+	std::vector<std::unique_ptr<StaticMeshToShapeConverter>> converters;
+	converters.reserve(mEntries.size());
+
+	//Send every read request before mapping any
+	auto start = Clock::now();
+	for (const auto& entry : mEntries)
+	{
+		converters.emplace_back(new StaticMeshToShapeConverter);
+		auto& converter = *converters.back();
+		converter.setThreadPool(mPool);
+
+		if (entry.item)
+		{
+			converter.requestItem(entry.item, entry.transform, entry.lod);
+		}
+		else
+		{
+			converter.setScale(entry.scale);
+			converter.requestMesh(entry.mesh, entry.transform, entry.lod);
+		}
+	}
+	mTimings.request = millisecondsSince(start);
+
+	//The first map waits for the GPU. The other transfers were queued with it, they're done by then
+	start = Clock::now();
+	try
+	{
+		for (auto& converter : converters)
+			converter->mapReadback();
+	}
+	catch (...)
+	{
+		//Unmap the converters mapped before the failure. The tickets of the others are freed with their requests
+		for (auto& converter : converters)
+			converter->releaseReadback();
+		throw;
+	}
+	mTimings.sync = millisecondsSince(start);
+
+	//The submeshes of each converter are decoded on the same pool, parallelFor nests
+	start = Clock::now();
+	try
+	{
+		forEach(converters.size(), [&](size_t i) { converters[i]->decodeReadback(); });
+	}
+	catch (...)
+	{
+		for (auto& converter : converters)
+			converter->releaseReadback();
+		throw;
+	}
+	mTimings.decode = millisecondsSince(start);
+
+	start = Clock::now();
+	for (auto& converter : converters)
+		converter->releaseReadback();
+	mTimings.sync += millisecondsSince(start);
+
+	return converters;
+}
+
+std::vector<btCollisionShape*> BatchConverter::convert(const ShapeBuilder& builder)
+{
+	auto converters = read();
+
+	//Owned until every builder succeeded, the shapes already built are deleted if one throws
+	const auto start = Clock::now();
+	std::vector<std::unique_ptr<btCollisionShape>> built(converters.size());
+	forEach(converters.size(), [&](size_t i)
+	{
+		if (converters[i]->getTriangleCount())
+			built[i].reset(builder(*converters[i]));
+	});
+	mTimings.build = millisecondsSince(start);
+
+	std::vector<btCollisionShape*> shapes;
+	shapes.reserve(built.size());
+	for (auto& shape : built)
+		shapes.push_back(shape.release());
+
+	logTimings();
+	return shapes;
+}
+
+btCollisionShape* BatchConverter::convertMerged(const ShapeBuilder& builder)
+{
+	auto converters = read();
+
+	const auto start = Clock::now();
+	StaticMeshToShapeConverter merged;
+	merged.setThreadPool(mPool);
+	for (const auto& converter : converters)
+		merged.merge(*converter);
+	converters.clear();
+
+	const auto shape = merged.getTriangleCount() ? builder(merged) : nullptr;
+	mTimings.build = millisecondsSince(start);
+
+	logTimings();
+	return shape;
+}
+
+void BatchConverter::logTimings() const
+{
+	log("BatchConverter : " + std::to_string(mEntries.size()) + " meshes : request " + std::to_string(mTimings.request)
+		+ " ms, sync " + std::to_string(mTimings.sync) + " ms, decode " + std::to_string(mTimings.decode)
+		+ " ms, build " + std::to_string(mTimings.build) + " ms");
+}
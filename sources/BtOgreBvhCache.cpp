@@ -0,0 +1,337 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreBvhCache.cpp
+ *
+ *    Description:  BtOgre on-disk BVH cache implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreBvhCache.h"
+#include "BtOgreInternal.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Ogre;
+using namespace BtOgre;
+using detail::log;
+
+namespace
+{
+	///Bump this when the file layout changes
+	constexpr uint32_t cacheFormatVersion{ 2 };
+
+	///First bytes of a cache file
+	constexpr char cacheMagic[8]{ 'B', 'T', 'O', 'G', 'R', 'B', 'V', 'H' };
+
+	///Header of a cache file. Everything is stored in native endianness
+	struct CacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t scalarSize;
+		uint64_t contentHash;
+		uint64_t bvhSize;
+		uint64_t triangleInfoCount;
+	};
+
+	///Tolerances of a btTriangleInfoMap, stored before its entries
+	struct TriangleInfoMapParameters
+	{
+		btScalar convexEpsilon;
+		btScalar planarEpsilon;
+		btScalar equalVertexThreshold;
+		btScalar edgeDistanceThreshold;
+		btScalar maxEdgeAngleThreshold;
+		btScalar zeroAreaThreshold;
+	};
+
+	///One entry of a btTriangleInfoMap
+	struct TriangleInfoEntry
+	{
+		int32_t key;
+		int32_t flags;
+		btScalar edgeV0V1Angle;
+		btScalar edgeV1V2Angle;
+		btScalar edgeV2V0Angle;
+	};
+
+	///FNV-1a, can be chained
+	uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+	{
+		const auto bytes = static_cast<const unsigned char*>(data);
+		for (auto i = size_t{ 0 }; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	///Name of a temporary file next to path, unique to this process, thread and call
+	std::string getTemporaryPath(const std::string& path)
+	{
+		static std::atomic<unsigned> counter{ 0 };
+#ifdef _WIN32
+		const auto process = static_cast<unsigned long long>(_getpid());
+#else
+		const auto process = static_cast<unsigned long long>(getpid());
+#endif
+		const auto thread = static_cast<unsigned long long>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		return path + "." + std::to_string(process) + "." + std::to_string(thread) + "." + std::to_string(counter++) + ".tmp";
+	}
+}
+
+BvhCache::BvhCache(std::string directory) :
+	mDirectory(std::move(directory)),
+	mLoads(0),
+	mBuilds(0)
+{
+	if (!mDirectory.empty() && mDirectory.back() != '/' && mDirectory.back() != '\\')
+		mDirectory += '/';
+}
+
+uint64_t BvhCache::hashContent(const VertexBuffer& vertices, const IndexBuffer& indices, const btVector3& scaling)
+{
+	const uint64_t counts[]{ vertices.size(), indices.size() };
+	auto hash = fnv1a(counts, sizeof counts);
+	hash = fnv1a(vertices.data(), vertices.size() * sizeof(Vector3), hash);
+	hash = fnv1a(indices.data(), indices.size() * sizeof(unsigned int), hash);
+	return fnv1a(scaling.m_floats, 3 * sizeof(btScalar), hash);
+}
+
+std::string BvhCache::getEntryPath(const std::string& name, uint64_t contentHash) const
+{
+	if (name.empty())
+	{
+		char hex[17];
+		std::snprintf(hex, sizeof hex, "%016llx", static_cast<unsigned long long>(contentHash));
+		return mDirectory + hex + ".btogrebvh";
+	}
+
+	//Mesh names often contain path separators
+	auto fileName = name;
+	for (auto& c : fileName)
+		if (c == '/' || c == '\\' || c == ':' || c == '*' || c == '?' || c == '"' || c == '<' || c == '>' || c == '|')
+			c = '_';
+
+	return mDirectory + fileName + ".btogrebvh";
+}
+
+OwningBvhTriangleMeshShape* BvhCache::createTrimesh(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling,
+	const std::string& name, bool internalEdgeInfo)
+{
+	const auto contentHash = hashContent(vertices, indices, scaling);
+	const auto path = getEntryPath(name, contentHash);
+
+	//Don't build the BVH yet, we'll try to load it first
+	const auto useQuantizedAABB = true;
+	auto shape = new OwningBvhTriangleMeshShape(std::move(vertices), std::move(indices), scaling, useQuantizedAABB, false);
+
+	if (load(path, contentHash, shape, internalEdgeInfo))
+	{
+		++mLoads;
+		return shape;
+	}
+
+	++mBuilds;
+	shape->buildOptimizedBvh();
+	if (internalEdgeInfo)
+		shape->generateInternalEdgeInfo();
+
+	if (!save(path, contentHash, shape))
+		log("BvhCache : Couldn't write " + path);
+
+	return shape;
+}
+
+bool BvhCache::load(const std::string& path, uint64_t contentHash, OwningBvhTriangleMeshShape* shape, bool internalEdgeInfo)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	//The sizes read from the file are checked against its length before anything is allocated
+	file.seekg(0, std::ios::end);
+	const auto fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0, std::ios::beg);
+
+	CacheHeader header;
+	if (fileSize < sizeof header || !file.read(reinterpret_cast<char*>(&header), sizeof header))
+	{
+		log("BvhCache : " + path + " is truncated, rebuilding it");
+		return false;
+	}
+
+	if (std::memcmp(header.magic, cacheMagic, sizeof cacheMagic) != 0
+		|| header.version != cacheFormatVersion
+		|| header.scalarSize != sizeof(btScalar))
+	{
+		log("BvhCache : " + path + " was written by another version, rebuilding it");
+		return false;
+	}
+
+	if (header.contentHash != contentHash)
+	{
+		log("BvhCache : " + path + " is stale, rebuilding it");
+		return false;
+	}
+
+	//A truncated or corrupted entry is stale too: the sizes must add up to the length of the file
+	const auto remaining = fileSize - sizeof header;
+	const auto triangleInfoSize = header.triangleInfoCount
+		? sizeof(TriangleInfoMapParameters) + header.triangleInfoCount * sizeof(TriangleInfoEntry) : uint64_t{ 0 };
+	if (!header.bvhSize || header.bvhSize > remaining || header.bvhSize > std::numeric_limits<unsigned int>::max()
+		|| header.triangleInfoCount > remaining / sizeof(TriangleInfoEntry)
+		|| header.bvhSize + triangleInfoSize != remaining)
+	{
+		log("BvhCache : " + path + " is corrupted, rebuilding it");
+		return false;
+	}
+
+	if (internalEdgeInfo && !header.triangleInfoCount)
+		return false;
+
+	//In place deserialization needs a 16 bytes aligned buffer, that will stay alive as long as the BVH
+	const auto bvhSize = static_cast<unsigned int>(header.bvhSize);
+	auto buffer = btAlignedAlloc(bvhSize, 16);
+	if (!file.read(static_cast<char*>(buffer), bvhSize))
+	{
+		btAlignedFree(buffer);
+		return false;
+	}
+
+	const auto bvh = static_cast<btOptimizedBvh*>(btOptimizedBvh::deSerializeInPlace(buffer, bvhSize, false));
+	if (!bvh)
+	{
+		btAlignedFree(buffer);
+		return false;
+	}
+
+	std::unique_ptr<btTriangleInfoMap> triangleInfoMap;
+	if (internalEdgeInfo)
+	{
+		TriangleInfoMapParameters parameters;
+		std::vector<TriangleInfoEntry> entries(header.triangleInfoCount);
+		if (!file.read(reinterpret_cast<char*>(&parameters), sizeof parameters)
+			|| !file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(TriangleInfoEntry)))
+		{
+			bvh->~btOptimizedBvh();
+			btAlignedFree(buffer);
+			return false;
+		}
+
+		triangleInfoMap.reset(new btTriangleInfoMap);
+		triangleInfoMap->m_convexEpsilon = parameters.convexEpsilon;
+		triangleInfoMap->m_planarEpsilon = parameters.planarEpsilon;
+		triangleInfoMap->m_equalVertexThreshold = parameters.equalVertexThreshold;
+		triangleInfoMap->m_edgeDistanceThreshold = parameters.edgeDistanceThreshold;
+		triangleInfoMap->m_maxEdgeAngleThreshold = parameters.maxEdgeAngleThreshold;
+		triangleInfoMap->m_zeroAreaThreshold = parameters.zeroAreaThreshold;
+
+		for (const auto& entry : entries)
+		{
+			btTriangleInfo info;
+			info.m_flags = entry.flags;
+			info.m_edgeV0V1Angle = entry.edgeV0V1Angle;
+			info.m_edgeV1V2Angle = entry.edgeV1V2Angle;
+			info.m_edgeV2V0Angle = entry.edgeV2V0Angle;
+			triangleInfoMap->insert(btHashInt(entry.key), info);
+		}
+	}
+
+	shape->adoptSerializedBvh(buffer, bvh);
+	if (triangleInfoMap)
+		shape->adoptTriangleInfoMap(triangleInfoMap.release());
+
+	return true;
+}
+
+bool BvhCache::save(const std::string& path, uint64_t contentHash, OwningBvhTriangleMeshShape* shape)
+{
+	const auto bvh = shape->getOptimizedBvh();
+	if (!bvh) return false;
+
+	const auto bvhSize = bvh->calculateSerializeBufferSize();
+	auto buffer = btAlignedAlloc(bvhSize, 16);
+	if (!bvh->serializeInPlace(buffer, bvhSize, false))
+	{
+		btAlignedFree(buffer);
+		return false;
+	}
+
+	const auto triangleInfoMap = shape->getTriangleInfoMap();
+
+	CacheHeader header;
+	std::memcpy(header.magic, cacheMagic, sizeof cacheMagic);
+	header.version = cacheFormatVersion;
+	header.scalarSize = sizeof(btScalar);
+	header.contentHash = contentHash;
+	header.bvhSize = bvhSize;
+	header.triangleInfoCount = triangleInfoMap ? uint64_t(triangleInfoMap->size()) : 0;
+
+	//Write to a temporary file and move it in place, so a crash never leaves a truncated entry behind
+	//The name is unique, so processes and threads saving the same entry don't write in each other's file
+	const auto temporaryPath = getTemporaryPath(path);
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof header);
+		file.write(static_cast<const char*>(buffer), bvhSize);
+
+		if (triangleInfoMap)
+		{
+			const TriangleInfoMapParameters parameters
+			{
+				triangleInfoMap->m_convexEpsilon,
+				triangleInfoMap->m_planarEpsilon,
+				triangleInfoMap->m_equalVertexThreshold,
+				triangleInfoMap->m_edgeDistanceThreshold,
+				triangleInfoMap->m_maxEdgeAngleThreshold,
+				triangleInfoMap->m_zeroAreaThreshold
+			};
+			file.write(reinterpret_cast<const char*>(&parameters), sizeof parameters);
+
+			for (auto i = 0; i < triangleInfoMap->size(); ++i)
+			{
+				const auto info = triangleInfoMap->getAtIndex(i);
+				const TriangleInfoEntry entry
+				{
+					triangleInfoMap->getKeyAtIndex(i).getUid1(),
+					info->m_flags,
+					info->m_edgeV0V1Angle,
+					info->m_edgeV1V2Angle,
+					info->m_edgeV2V0Angle
+				};
+				file.write(reinterpret_cast<const char*>(&entry), sizeof entry);
+			}
+		}
+
+		btAlignedFree(buffer);
+		if (!file)
+		{
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(path.c_str());
+	return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
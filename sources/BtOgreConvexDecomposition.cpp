@@ -0,0 +1,421 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreConvexDecomposition.cpp
+ *
+ *    Description:  BtOgre approximate convex decomposition implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreConvexDecomposition.h"
+#include "BtOgreConvexHull.h"
+#include "BtOgreExtras.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <LinearMath/btConvexHullComputer.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Most rays cast from a hull to measure its concavity
+	constexpr size_t maxConcavitySamples{ 512 };
+
+	///Convex hull with its faces as loops of vertex indices
+	struct Hull
+	{
+		std::vector<Vector3> vertices;
+		std::vector<std::vector<int>> faces;
+		Vector3 centroid;
+	};
+
+	///Piece of the mesh being decomposed
+	struct Part
+	{
+		///Indices of its triangles in the mesh
+		std::vector<unsigned> triangles;
+
+		///How deep the mesh is inside the part's hull
+		Real concavity;
+
+		///False once a split failed to put triangles on both sides
+		bool splittable;
+	};
+
+	///The mesh being decomposed
+	struct SourceMesh
+	{
+		const Vector3* vertices;
+		const unsigned* indices;
+		std::vector<Vector3> centroids;
+
+		const Vector3& corner(unsigned triangle, unsigned i) const
+		{
+			return vertices[indices[3 * triangle + i]];
+		}
+	};
+
+	void computeHull(const std::vector<Vector3>& points, Hull& hull)
+	{
+		hull.vertices.clear();
+		hull.faces.clear();
+		hull.centroid = Vector3::ZERO;
+		if (points.size() < 4) return;
+
+		btConvexHullComputer computer;
+		computer.compute(&points[0].x, int(sizeof(Vector3)), int(points.size()), 0, 0);
+
+		hull.vertices.resize(size_t(computer.vertices.size()));
+		for (auto i = 0; i < computer.vertices.size(); ++i)
+		{
+			hull.vertices[i] = Convert::toOgre(computer.vertices[i]);
+			hull.centroid += hull.vertices[i];
+		}
+		if (!hull.vertices.empty())
+			hull.centroid /= Real(hull.vertices.size());
+
+		hull.faces.resize(size_t(computer.faces.size()));
+		for (auto i = 0; i < computer.faces.size(); ++i)
+		{
+			const auto first = &computer.edges[computer.faces[i]];
+			auto edge = first;
+			do
+			{
+				hull.faces[i].push_back(edge->getSourceVertex());
+				edge = edge->getNextEdgeOfFace();
+			} while (edge != first);
+		}
+	}
+
+	///Volume of a hull, as the sum of the tetrahedrons between its centroid and its faces
+	Real hullVolume(const Hull& hull)
+	{
+		auto volume = Real(0);
+		for (const auto& face : hull.faces)
+		{
+			const auto& a = hull.vertices[face[0]];
+			for (size_t i = 1; i + 1 < face.size(); ++i)
+			{
+				const auto& b = hull.vertices[face[i]];
+				const auto& c = hull.vertices[face[i + 1]];
+				volume += std::abs((b - a).crossProduct(c - a).dotProduct(hull.centroid - a));
+			}
+		}
+		return volume / 6;
+	}
+
+	///Gather the corners of these triangles
+	void gatherPoints(const SourceMesh& mesh, const std::vector<unsigned>& triangles, std::vector<Vector3>& points)
+	{
+		points.clear();
+		points.reserve(3 * triangles.size());
+		for (const auto triangle : triangles)
+			for (auto i = 0u; i < 3; ++i)
+				points.push_back(mesh.corner(triangle, i));
+	}
+
+	///Distance along the ray to the nearest triangle (either side), and if that triangle faces the ray
+	bool castRay(const SourceMesh& mesh, const std::vector<unsigned>& triangles, const Vector3& origin, const Vector3& direction,
+		Real& nearest, bool& frontFacing)
+	{
+		nearest = std::numeric_limits<Real>::max();
+		auto hit = false;
+
+		for (const auto triangle : triangles)
+		{
+			//Moller-Trumbore
+			const auto& a = mesh.corner(triangle, 0);
+			const auto edge1 = mesh.corner(triangle, 1) - a;
+			const auto edge2 = mesh.corner(triangle, 2) - a;
+			const auto p = direction.crossProduct(edge2);
+			const auto determinant = edge1.dotProduct(p);
+			if (std::abs(determinant) <= std::numeric_limits<Real>::epsilon()) continue;
+
+			const auto inverse = 1 / determinant;
+			const auto s = origin - a;
+			const auto u = s.dotProduct(p) * inverse;
+			if (u < 0 || u > 1) continue;
+
+			const auto q = s.crossProduct(edge1);
+			const auto v = direction.dotProduct(q) * inverse;
+			if (v < 0 || u + v > 1) continue;
+
+			const auto t = edge2.dotProduct(q) * inverse;
+			if (t < 0 || t >= nearest) continue;
+
+			nearest = t;
+			frontFacing = determinant > 0;
+			hit = true;
+		}
+
+		return hit;
+	}
+
+	///Cast rays inward from points on the hull faces. A ray that first meets the front of a triangle started outside of the
+	///mesh, the distance to that triangle is how concave the part is there. Meeting a back face means the hull is on the mesh
+	Real computeConcavity(const SourceMesh& mesh, const std::vector<unsigned>& triangles)
+	{
+		std::vector<Vector3> points;
+		gatherPoints(mesh, triangles, points);
+
+		Hull hull;
+		computeHull(points, hull);
+
+		//Face centers, and points halfway between them and the face corners
+		std::vector<std::pair<Vector3, Vector3>> samples;
+		for (const auto& face : hull.faces)
+		{
+			if (face.size() < 3) continue;
+
+			const auto& a = hull.vertices[face[0]];
+			auto normal = (hull.vertices[face[1]] - a).crossProduct(hull.vertices[face[2]] - a);
+			if (normal.normalise() == 0) continue;
+			if (normal.dotProduct(hull.centroid - a) > 0) normal = -normal;
+
+			auto center = Vector3::ZERO;
+			for (const auto i : face) center += hull.vertices[i];
+			center /= Real(face.size());
+
+			samples.emplace_back(center, -normal);
+			for (const auto i : face)
+				samples.emplace_back(center.midPoint(hull.vertices[i]), -normal);
+		}
+
+		const auto stride = std::max(size_t{ 1 }, (samples.size() + maxConcavitySamples - 1) / maxConcavitySamples);
+
+		auto concavity = Real(0);
+		for (auto i = size_t{ 0 }; i < samples.size(); i += stride)
+		{
+			Real distance;
+			bool frontFacing;
+			if (castRay(mesh, triangles, samples[i].first, samples[i].second, distance, frontFacing) && frontFacing)
+				concavity = std::max(concavity, distance);
+		}
+
+		return concavity;
+	}
+
+	///Try the candidate planes and split the part along the best one. Return false if no plane puts triangles on both sides
+	bool splitPart(const SourceMesh& mesh, const Part& part, unsigned planesPerAxis, Part& left, Part& right, ThreadPool* pool)
+	{
+		auto minimum = Vector3(std::numeric_limits<Real>::max());
+		auto maximum = Vector3(-std::numeric_limits<Real>::max());
+		for (const auto triangle : part.triangles)
+		{
+			minimum.makeFloor(mesh.centroids[triangle]);
+			maximum.makeCeil(mesh.centroids[triangle]);
+		}
+
+		struct Candidate
+		{
+			unsigned axis;
+			Real position;
+			Real volume;
+		};
+
+		std::vector<Candidate> candidates;
+		for (auto axis = 0u; axis < 3; ++axis)
+			for (auto i = 1u; i <= planesPerAxis; ++i)
+				if (maximum[axis] > minimum[axis])
+					candidates.push_back({ axis, minimum[axis] + (maximum[axis] - minimum[axis]) * i / (planesPerAxis + 1),
+						std::numeric_limits<Real>::max() });
+
+		const auto evaluate = [&](size_t c)
+		{
+			auto& candidate = candidates[c];
+			std::vector<unsigned> sides[2];
+			for (const auto triangle : part.triangles)
+				sides[mesh.centroids[triangle][candidate.axis] < candidate.position ? 0 : 1].push_back(triangle);
+
+			if (sides[0].empty() || sides[1].empty()) return;
+
+			std::vector<Vector3> points;
+			Hull hull;
+			candidate.volume = 0;
+			for (const auto& side : sides)
+			{
+				gatherPoints(mesh, side, points);
+				computeHull(points, hull);
+				candidate.volume += hullVolume(hull);
+			}
+		};
+
+		if (pool)
+			pool->parallelFor(candidates.size(), evaluate);
+		else
+			for (auto c = size_t{ 0 }; c < candidates.size(); ++c) evaluate(c);
+
+		//First best candidate, so ties don't depend on the evaluation order
+		auto best = candidates.size();
+		for (auto c = size_t{ 0 }; c < candidates.size(); ++c)
+			if (candidates[c].volume < std::numeric_limits<Real>::max()
+				&& (best == candidates.size() || candidates[c].volume < candidates[best].volume))
+				best = c;
+
+		if (best == candidates.size())
+			return false;
+
+		left.triangles.clear();
+		right.triangles.clear();
+		for (const auto triangle : part.triangles)
+			(mesh.centroids[triangle][candidates[best].axis] < candidates[best].position ? left : right).triangles.push_back(triangle);
+
+		left.concavity = computeConcavity(mesh, left.triangles);
+		right.concavity = computeConcavity(mesh, right.triangles);
+		left.splittable = right.splittable = true;
+		return true;
+	}
+}
+
+ConvexDecomposition::ConvexDecomposition(const ConvexDecompositionSettings& settings) :
+	mSettings(settings)
+{
+	mSettings.maxHulls = std::max(1u, mSettings.maxHulls);
+	mSettings.planesPerAxis = std::max(1u, mSettings.planesPerAxis);
+}
+
+const ConvexDecompositionSettings& ConvexDecomposition::getSettings() const
+{
+	return mSettings;
+}
+
+std::vector<std::vector<Vector3>> ConvexDecomposition::decompose(const Vector3* vertices, size_t vertexCount,
+	const unsigned* indices, size_t indexCount, ThreadPool* pool) const
+{
+	const auto triangleCount = indexCount / 3;
+	if (!vertexCount || !triangleCount) return {};
+
+	SourceMesh mesh{ vertices, indices, std::vector<Vector3>(triangleCount) };
+	for (auto triangle = 0u; triangle < triangleCount; ++triangle)
+		mesh.centroids[triangle] = (mesh.corner(triangle, 0) + mesh.corner(triangle, 1) + mesh.corner(triangle, 2)) / 3;
+
+	auto minimum = vertices[0];
+	auto maximum = vertices[0];
+	for (auto i = size_t{ 1 }; i < vertexCount; ++i)
+	{
+		minimum.makeFloor(vertices[i]);
+		maximum.makeCeil(vertices[i]);
+	}
+	const auto concavityLimit = mSettings.concavity * minimum.distance(maximum);
+
+	std::vector<Part> parts(1);
+	parts[0].triangles.resize(triangleCount);
+	for (auto triangle = 0u; triangle < triangleCount; ++triangle)
+		parts[0].triangles[triangle] = triangle;
+	parts[0].concavity = computeConcavity(mesh, parts[0].triangles);
+	parts[0].splittable = true;
+
+	//Split in rounds: the most concave parts first, as many as the hull budget allows. The parts of a round are split in parallel,
+	//but what is split and where the children go only depends on the previous rounds
+	while (parts.size() < mSettings.maxHulls)
+	{
+		std::vector<size_t> toSplit;
+		for (auto i = size_t{ 0 }; i < parts.size(); ++i)
+			if (parts[i].splittable && parts[i].concavity > concavityLimit)
+				toSplit.push_back(i);
+
+		if (toSplit.empty()) break;
+
+		std::stable_sort(begin(toSplit), end(toSplit), [&](size_t a, size_t b) { return parts[a].concavity > parts[b].concavity; });
+		toSplit.resize(std::min(toSplit.size(), mSettings.maxHulls - parts.size()));
+
+		std::vector<Part> children(2 * toSplit.size());
+		std::vector<char> split(toSplit.size());
+		const auto splitOne = [&](size_t i)
+		{
+			split[i] = splitPart(mesh, parts[toSplit[i]], mSettings.planesPerAxis, children[2 * i], children[2 * i + 1], pool);
+		};
+
+		if (pool)
+			pool->parallelFor(toSplit.size(), splitOne);
+		else
+			for (auto i = size_t{ 0 }; i < toSplit.size(); ++i) splitOne(i);
+
+		for (auto i = size_t{ 0 }; i < toSplit.size(); ++i)
+		{
+			auto& part = parts[toSplit[i]];
+			if (!split[i])
+			{
+				part.splittable = false;
+				continue;
+			}
+
+			part = std::move(children[2 * i]);
+			parts.push_back(std::move(children[2 * i + 1]));
+		}
+	}
+
+	//Unique corners of each part
+	std::vector<std::vector<Vector3>> result(parts.size());
+	for (auto i = size_t{ 0 }; i < parts.size(); ++i)
+	{
+		std::vector<unsigned> used;
+		used.reserve(3 * parts[i].triangles.size());
+		for (const auto triangle : parts[i].triangles)
+			for (auto corner = 0u; corner < 3; ++corner)
+				used.push_back(indices[3 * triangle + corner]);
+
+		std::sort(begin(used), end(used));
+		used.erase(std::unique(begin(used), end(used)), end(used));
+
+		result[i].reserve(used.size());
+		for (const auto index : used)
+			result[i].push_back(vertices[index]);
+	}
+
+	return result;
+}
+
+btCompoundShape* ConvexDecomposition::build(const Vector3* vertices, size_t vertexCount,
+	const unsigned* indices, size_t indexCount, const btVector3& scaling, ThreadPool* pool) const
+{
+	const auto parts = decompose(vertices, vertexCount, indices, indexCount, pool);
+	const auto scale = Convert::toOgre(scaling);
+
+	//Hulls are built around the center of their part, scaled up front so their polyhedral features match
+	const ConvexHullBuilder builder(mSettings.maxVerticesPerHull);
+	std::vector<btConvexHullShape*> hulls(parts.size(), nullptr);
+	std::vector<Vector3> centers(parts.size());
+	const auto buildOne = [&](size_t i)
+	{
+		auto minimum = parts[i][0];
+		auto maximum = parts[i][0];
+		for (const auto& point : parts[i])
+		{
+			minimum.makeFloor(point);
+			maximum.makeCeil(point);
+		}
+		centers[i] = minimum.midPoint(maximum);
+
+		std::vector<Vector3> points(parts[i].size());
+		for (auto j = size_t{ 0 }; j < points.size(); ++j)
+			points[j] = (parts[i][j] - centers[i]) * scale;
+
+		hulls[i] = builder.build(points.data(), points.size());
+	};
+
+	if (pool)
+		pool->parallelFor(parts.size(), buildOne);
+	else
+		for (auto i = size_t{ 0 }; i < parts.size(); ++i) buildOne(i);
+
+	auto compound = new btCompoundShape(true, int(hulls.size()));
+	for (auto i = size_t{ 0 }; i < hulls.size(); ++i)
+	{
+		btTransform transform;
+		transform.setIdentity();
+		transform.setOrigin(Convert::toBullet(centers[i] * scale));
+		compound->addChildShape(transform, hulls[i]);
+	}
+
+	return compound;
+}
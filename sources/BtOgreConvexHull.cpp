@@ -0,0 +1,273 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreConvexHull.cpp
+ *
+ *    Description:  BtOgre vertex budgeted convex hull builder implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreConvexHull.h"
+
+#include <LinearMath/btConvexHullComputer.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Face of a hull. Distance of a point outside of it is normal.dotProduct(point) - distance
+	struct Plane
+	{
+		Vector3 normal;
+		Real distance;
+	};
+
+	///Compute the convex hull of the points with Bullet. Get its vertices and, optionally, the planes of its faces
+	void computeRealHull(const Vector3* points, size_t count, std::vector<Vector3>& vertices, std::vector<Plane>* planes)
+	{
+		btConvexHullComputer computer;
+		computer.compute(&points[0].x, int(sizeof(Vector3)), int(count), 0, 0);
+
+		vertices.resize(size_t(computer.vertices.size()));
+		auto centroid = Vector3::ZERO;
+		for (auto i = 0; i < computer.vertices.size(); ++i)
+		{
+			vertices[i] = Convert::toOgre(computer.vertices[i]);
+			centroid += vertices[i];
+		}
+
+		if (!planes || vertices.empty()) return;
+		centroid /= Real(vertices.size());
+
+		planes->clear();
+		planes->reserve(size_t(computer.faces.size()));
+		for (auto i = 0; i < computer.faces.size(); ++i)
+		{
+			const auto edge = &computer.edges[computer.faces[i]];
+			const auto next = edge->getNextEdgeOfFace();
+			const auto& a = vertices[edge->getSourceVertex()];
+			const auto& b = vertices[edge->getTargetVertex()];
+			const auto& c = vertices[next->getTargetVertex()];
+
+			auto normal = (b - a).crossProduct(c - a);
+			if (normal.normalise() == 0) continue;
+
+			//Make sure the normal points outside
+			if (normal.dotProduct(centroid - a) > 0)
+				normal = -normal;
+
+			planes->push_back({ normal, normal.dotProduct(a) });
+		}
+	}
+
+	///Distance of the point outside of the hull bounded by these planes. Negative inside
+	Real distanceOutside(const std::vector<Plane>& planes, const Vector3& point)
+	{
+		auto distance = -std::numeric_limits<Real>::max();
+		for (const auto& plane : planes)
+			distance = std::max(distance, plane.normal.dotProduct(point) - plane.distance);
+		return distance;
+	}
+
+	///Index of the point the farthest from the given one
+	size_t farthestFrom(const std::vector<Vector3>& points, const Vector3& from)
+	{
+		auto farthest = size_t{ 0 };
+		auto farthestDistance = Real(-1);
+		for (auto i = size_t{ 0 }; i < points.size(); ++i)
+		{
+			const auto distance = points[i].squaredDistance(from);
+			if (distance > farthestDistance)
+			{
+				farthest = i;
+				farthestDistance = distance;
+			}
+		}
+		return farthest;
+	}
+
+	///Reduce a flat hull with farthest point sampling, planes can't measure how far a point is in that case
+	std::vector<Vector3> reduceFlatHull(const std::vector<Vector3>& hull, size_t budget, Real maxError, Real& error)
+	{
+		std::vector<Real> distances(hull.size(), std::numeric_limits<Real>::max());
+		std::vector<Vector3> reduced;
+
+		auto next = size_t{ 0 };
+		for (;;)
+		{
+			reduced.push_back(hull[next]);
+
+			error = 0;
+			for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+			{
+				distances[i] = std::min(distances[i], hull[i].distance(reduced.back()));
+				if (distances[i] > error)
+				{
+					error = distances[i];
+					next = i;
+				}
+			}
+
+			if (error <= maxError || reduced.size() >= budget)
+				return reduced;
+		}
+	}
+}
+
+ConvexHullBuilder::ConvexHullBuilder(unsigned vertexBudget, Real maxError) :
+	mVertexBudget(std::max(4u, vertexBudget)),
+	mMaxError(maxError),
+	mPolyhedralFeatures(true)
+{
+}
+
+void ConvexHullBuilder::setVertexBudget(unsigned vertexBudget)
+{
+	mVertexBudget = std::max(4u, vertexBudget);
+}
+
+unsigned ConvexHullBuilder::getVertexBudget() const
+{
+	return mVertexBudget;
+}
+
+void ConvexHullBuilder::setMaxError(Real maxError)
+{
+	mMaxError = maxError;
+}
+
+Real ConvexHullBuilder::getMaxError() const
+{
+	return mMaxError;
+}
+
+void ConvexHullBuilder::setPolyhedralFeatures(bool polyhedralFeatures)
+{
+	mPolyhedralFeatures = polyhedralFeatures;
+}
+
+std::vector<Vector3> ConvexHullBuilder::computeHull(const Vector3* points, size_t count, Real* error) const
+{
+	if (error) *error = 0;
+	if (!count) return {};
+
+	std::vector<Vector3> hull;
+	computeRealHull(points, count, hull, nullptr);
+
+	if (hull.size() <= mVertexBudget)
+		return hull;
+
+	//Seed with a tetrahedron as big as possible: two far apart vertices, the farthest from their line, the farthest from their plane
+	const auto i0 = farthestFrom(hull, hull[0]);
+	const auto i1 = farthestFrom(hull, hull[i0]);
+	const auto axis = (hull[i1] - hull[i0]).normalisedCopy();
+
+	auto i2 = i0;
+	auto lineDistance = Real(0);
+	for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+	{
+		const auto distance = axis.crossProduct(hull[i] - hull[i0]).squaredLength();
+		if (distance > lineDistance)
+		{
+			i2 = i;
+			lineDistance = distance;
+		}
+	}
+
+	const auto normal = axis.crossProduct(hull[i2] - hull[i0]).normalisedCopy();
+	auto i3 = i0;
+	auto planeDistance = Real(0);
+	for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+	{
+		const auto distance = std::abs(normal.dotProduct(hull[i] - hull[i0]));
+		if (distance > planeDistance)
+		{
+			i3 = i;
+			planeDistance = distance;
+		}
+	}
+
+	Real reducedError;
+	if (planeDistance <= std::numeric_limits<Real>::epsilon() * hull[i0].distance(hull[i1]))
+	{
+		auto reduced = reduceFlatHull(hull, mVertexBudget, mMaxError, reducedError);
+		if (error) *error = reducedError;
+		return reduced;
+	}
+
+	std::vector<bool> selected(hull.size(), false);
+	std::vector<Vector3> reduced;
+	reduced.reserve(mVertexBudget);
+	for (const auto i : { i0, i1, i2, i3 })
+	{
+		selected[i] = true;
+		reduced.push_back(hull[i]);
+	}
+
+	//Add the vertex the farthest outside the reduced hull until it's close enough or the budget is spent
+	std::vector<Vector3> reducedVertices;
+	std::vector<Plane> planes;
+	for (;;)
+	{
+		computeRealHull(reduced.data(), reduced.size(), reducedVertices, &planes);
+
+		auto farthest = hull.size();
+		reducedError = 0;
+		for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+		{
+			if (selected[i]) continue;
+
+			const auto distance = distanceOutside(planes, hull[i]);
+			if (distance > reducedError)
+			{
+				farthest = i;
+				reducedError = distance;
+			}
+		}
+
+		if (farthest == hull.size() || reducedError <= mMaxError || reduced.size() >= mVertexBudget)
+			break;
+
+		selected[farthest] = true;
+		reduced.push_back(hull[farthest]);
+	}
+
+	if (error) *error = reducedError;
+	return reduced;
+}
+
+btConvexHullShape* ConvexHullBuilder::build(const Vector3* points, size_t count, const btVector3& scaling, Real* error) const
+{
+	const auto vertices = computeHull(points, count, error);
+
+	auto shape = new btConvexHullShape;
+	for (const auto& vertex : vertices)
+		shape->addPoint(Convert::toBullet(vertex), false);
+
+	//Also updates the local AABB. Polyhedral features are computed from the scaled vertices, so scale first
+	shape->setLocalScaling(scaling);
+
+	if (mPolyhedralFeatures && vertices.size() >= 4)
+		shape->initializePolyhedralFeatures();
+
+	return shape;
+}
+
+std::vector<btConvexHullShape*> ConvexHullBuilder::build(const std::vector<PointSet>& pointSets, ThreadPool* pool) const
+{
+	std::vector<btConvexHullShape*> shapes(pointSets.size(), nullptr);
+
+	const auto buildOne = [&](size_t i) { shapes[i] = build(pointSets[i].points, pointSets[i].count); };
+	if (pool)
+		pool->parallelFor(pointSets.size(), buildOne);
+	else
+		for (auto i = size_t{ 0 }; i < pointSets.size(); ++i) buildOne(i);
+
+	return shapes;
+}
@@ -16,11 +16,23 @@
 #include "BtOgrePG.h"
 #include "BtOgreGP.h"
 #include "BtOgreExtras.h"
+#include "BtOgreBvhCache.h"
+#include "BtOgreConvexHull.h"
+#include "BtOgreVertexKernels.h"
+#include "BtOgreInternal.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
 
 #include <Vao/OgreIndexBufferPacked.h>
+#include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
+#include <LinearMath/btConvexHullComputer.h>
 
 using namespace Ogre;
 using namespace BtOgre;
+using detail::log;
+using detail::makeEmptyBounds;
 
 /*
  * =============================================================================================
@@ -28,9 +40,249 @@ using namespace BtOgre;
  * =============================================================================================
  */
 
-inline void log(const std::string& message)
+///Volume of the convex hull of the points
+inline Real getHullVolume(const Vector3* points, size_t count)
+{
+	btConvexHullComputer computer;
+	computer.compute(&points[0].x, sizeof(Vector3), static_cast<int>(count), 0, 0);
+
+	//Sum the signed volumes of the tetrahedra from the origin to a fan of triangles on each face
+	auto volume = btScalar(0);
+	for (auto f = 0; f < computer.faces.size(); ++f)
+	{
+		const auto first = &computer.edges[computer.faces[f]];
+		const auto& origin = computer.vertices[first->getSourceVertex()];
+		for (auto edge = first->getNextEdgeOfFace(); edge->getTargetVertex() != first->getSourceVertex(); edge = edge->getNextEdgeOfFace())
+			volume += origin.dot(computer.vertices[edge->getSourceVertex()].cross(computer.vertices[edge->getTargetVertex()]));
+	}
+	return Real(std::abs(volume) / 6);
+}
+
+///Name of a best fit candidate, for the logs
+inline std::string getFitName(const PrimitiveFit& fit)
+{
+	switch (fit.kind)
+	{
+	case ShapeKind::Sphere: return "sphere";
+	case ShapeKind::Capsule: return "capsule";
+	case ShapeKind::Box: return fit.oriented ? "oriented box" : "box";
+	case ShapeKind::Cylinder: return "cylinder";
+	case ShapeKind::Convex: return "hull";
+	default: return "shape";
+	}
+}
+
+///Index data of a v1 submesh at the given LOD level, or at the nearest level it has
+inline v1::IndexData* getV1LodIndexData(const v1::SubMesh* subMesh, unsigned short level)
+{
+	//Level 0 is the submesh index data, the lower levels are in the LOD face list
+	const auto& lodFaces = subMesh->mLodFaceList[0];
+	if (level == 0 || lodFaces.empty())
+		return subMesh->indexData[0];
+	return lodFaces[std::min<size_t>(level, lodFaces.size()) - 1];
+}
+
+MeshLod::MeshLod(unsigned short level) :
+	level(level),
+	maxTriangles(0)
+{
+}
+
+MeshLod MeshLod::triangleBudget(size_t maxTriangles)
+{
+	MeshLod lod;
+	lod.maxTriangles = maxTriangles;
+	return lod;
+}
+
+unsigned short MeshLod::resolve(const Mesh* mesh) const
+{
+	auto levels = size_t{ 0 };
+	for (const auto subMesh : mesh->getSubMeshes())
+		levels = std::max<size_t>(levels, subMesh->mVao[0].size());
+
+	if (levels == 0) return 0;
+	if (!maxTriangles) return static_cast<unsigned short>(std::min<size_t>(level, levels - 1));
+
+	for (auto candidate = size_t{ 0 }; candidate < levels; ++candidate)
+		if (getTriangleCount(mesh, static_cast<unsigned short>(candidate)) <= maxTriangles)
+			return static_cast<unsigned short>(candidate);
+
+	return static_cast<unsigned short>(levels - 1);
+}
+
+unsigned short MeshLod::resolve(const v1::Mesh* mesh) const
+{
+	const auto levels = size_t{ mesh->getNumLodLevels() };
+
+	if (levels == 0) return 0;
+	if (!maxTriangles) return static_cast<unsigned short>(std::min<size_t>(level, levels - 1));
+
+	for (auto candidate = size_t{ 0 }; candidate < levels; ++candidate)
+		if (getTriangleCount(mesh, static_cast<unsigned short>(candidate)) <= maxTriangles)
+			return static_cast<unsigned short>(candidate);
+
+	return static_cast<unsigned short>(levels - 1);
+}
+
+size_t MeshLod::getTriangleCount(const Mesh* mesh, unsigned short level)
+{
+	auto triangles = size_t{ 0 };
+	for (const auto subMesh : mesh->getSubMeshes())
+	{
+		const auto& vaos = subMesh->mVao[0];
+		if (vaos.empty()) continue;
+
+		const auto vao = vaos[std::min<size_t>(level, vaos.size() - 1)];
+		const auto indexBuffer = vao->getIndexBuffer();
+		triangles += (indexBuffer ? indexBuffer->getNumElements() : vao->getVertexBuffers()[0]->getNumElements()) / 3;
+	}
+	return triangles;
+}
+
+size_t MeshLod::getTriangleCount(const v1::Mesh* mesh, unsigned short level)
+{
+	auto triangles = size_t{ 0 };
+	for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+		triangles += getV1LodIndexData(mesh->getSubMesh(i), level)->indexCount / 3;
+	return triangles;
+}
+
+detail::TrimeshStorage::TrimeshStorage(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling) :
+	mVertices(std::move(vertices)),
+	mIndices(std::move(indices))
+{
+	if (!addShortParts())
+		addIntegerPart();
+
+	mMeshInterface.setScaling(scaling);
+}
+
+bool detail::TrimeshStorage::addShortParts()
+{
+	//The quantized BVH keeps the part and triangle of each leaf in 10 and 21 bits
+	constexpr auto maxParts = size_t{ 1 } << 10;
+	constexpr auto maxPartTriangles = size_t{ 1 } << 21;
+	constexpr auto maxSpan = unsigned{ std::numeric_limits<uint16_t>::max() };
+
+	struct ShortPart
+	{
+		size_t firstTriangle;
+		size_t triangleCount;
+		unsigned firstVertex;
+		unsigned lastVertex;
+	};
+
+	//Grow each part as long as the vertices it uses fit in a 16 bits range. Welded meshes are mostly local, so few parts are needed
+	const auto triangleCount = mIndices.size() / 3;
+	if (!triangleCount) return false;
+
+	std::vector<ShortPart> parts;
+	for (auto t = size_t{ 0 }; t < triangleCount; ++t)
+	{
+		const auto triangle = &mIndices[3 * t];
+		const auto low = std::min({ triangle[0], triangle[1], triangle[2] });
+		const auto high = std::max({ triangle[0], triangle[1], triangle[2] });
+		if (high - low > maxSpan) return false;
+
+		if (!parts.empty())
+		{
+			auto& part = parts.back();
+			const auto firstVertex = std::min(part.firstVertex, low);
+			const auto lastVertex = std::max(part.lastVertex, high);
+			if (lastVertex - firstVertex <= maxSpan && part.triangleCount < maxPartTriangles)
+			{
+				part.firstVertex = firstVertex;
+				part.lastVertex = lastVertex;
+				++part.triangleCount;
+				continue;
+			}
+		}
+
+		if (parts.size() == maxParts) return false;
+		parts.push_back({ t, 1, low, high });
+	}
+
+	mShortIndices.resize(mIndices.size());
+	for (const auto& part : parts)
+	{
+		const auto first = 3 * part.firstTriangle;
+		const auto last = first + 3 * part.triangleCount;
+		for (auto i = first; i < last; ++i)
+			mShortIndices[i] = uint16_t(mIndices[i] - part.firstVertex);
+
+		btIndexedMesh indexedMesh;
+		indexedMesh.m_numTriangles = int(part.triangleCount);
+		indexedMesh.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(mShortIndices.data() + first);
+		indexedMesh.m_triangleIndexStride = 3 * sizeof(uint16_t);
+		indexedMesh.m_numVertices = int(part.lastVertex - part.firstVertex + 1);
+		indexedMesh.m_vertexBase = reinterpret_cast<const unsigned char*>(mVertices.data() + part.firstVertex);
+		indexedMesh.m_vertexStride = sizeof(Vector3);
+		indexedMesh.m_vertexType = sizeof(Real) == sizeof(double) ? PHY_DOUBLE : PHY_FLOAT;
+		indexedMesh.m_indexType = PHY_SHORT;
+
+		mMeshInterface.addIndexedMesh(indexedMesh, PHY_SHORT);
+	}
+
+	//The 32 bits copy isn't referenced anymore
+	IndexBuffer().swap(mIndices);
+	return true;
+}
+
+void detail::TrimeshStorage::addIntegerPart()
 {
-	LogManager::getSingleton().logMessage("BtOgreLog : " + message);
+	btIndexedMesh part;
+	part.m_numTriangles = int(mIndices.size() / 3);
+	part.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(mIndices.data());
+	part.m_triangleIndexStride = 3 * sizeof(unsigned int);
+	part.m_numVertices = int(mVertices.size());
+	part.m_vertexBase = reinterpret_cast<const unsigned char*>(mVertices.data());
+	part.m_vertexStride = sizeof(Vector3);
+	part.m_vertexType = sizeof(Real) == sizeof(double) ? PHY_DOUBLE : PHY_FLOAT;
+	part.m_indexType = PHY_INTEGER;
+
+	mMeshInterface.addIndexedMesh(part, PHY_INTEGER);
+}
+
+OwningBvhTriangleMeshShape::OwningBvhTriangleMeshShape(VertexBuffer&& vertices, IndexBuffer&& indices, const btVector3& scaling,
+	bool useQuantizedAabbCompression, bool buildBvh) :
+	TrimeshStorage(std::move(vertices), std::move(indices), scaling),
+	btBvhTriangleMeshShape(&mMeshInterface, useQuantizedAabbCompression, buildBvh),
+	mSerializedBvh(nullptr)
+{
+}
+
+OwningBvhTriangleMeshShape::~OwningBvhTriangleMeshShape()
+{
+	if (mSerializedBvh)
+	{
+		//The BVH was placement-constructed in our buffer by deSerializeInPlace, Bullet doesn't own it
+		m_bvh->~btOptimizedBvh();
+		m_bvh = nullptr;
+		btAlignedFree(mSerializedBvh);
+	}
+}
+
+void OwningBvhTriangleMeshShape::adoptSerializedBvh(void* buffer, btOptimizedBvh* bvh)
+{
+	assert(!m_bvh && "This shape already has a BVH");
+
+	mSerializedBvh = buffer;
+	setOptimizedBvh(bvh, getLocalScaling());
+}
+
+btTriangleInfoMap* OwningBvhTriangleMeshShape::generateInternalEdgeInfo()
+{
+	auto triangleInfoMap = new btTriangleInfoMap;
+	btGenerateInternalEdgeInfo(this, triangleInfoMap);
+	adoptTriangleInfoMap(triangleInfoMap);
+	return triangleInfoMap;
+}
+
+void OwningBvhTriangleMeshShape::adoptTriangleInfoMap(btTriangleInfoMap* triangleInfoMap)
+{
+	mOwnedTriangleInfoMap.reset(triangleInfoMap);
+	setTriangleInfoMap(triangleInfoMap);
 }
 
 void VertexIndexToShape::appendV1VertexData(const v1::VertexData *vertex_data)
@@ -48,20 +300,29 @@ void VertexIndexToShape::appendV1VertexData(const v1::VertexData *vertex_data)
 	const auto vertexSize = static_cast<unsigned int>(vbuf->getVertexSize());
 
 	//Get read only access to the row buffer
-	const auto vertex = static_cast<unsigned char*>(vbuf->lock(v1::HardwareBuffer::HBL_READ_ONLY));
-	Real* rawVertex{ nullptr }; // this pointer will be used a a buffer to write the [float, float, float] array of the vertex
+	const auto vertex = static_cast<const unsigned char*>(vbuf->lock(v1::HardwareBuffer::HBL_READ_ONLY));
 
-	//Write data to the vertex buffer
+	//Write data to the vertex buffer, the kernels compute the bounds on the way
 	const auto vertexCount = static_cast<unsigned int>(vertex_data->vertexCount);
-	for (auto j = size_t{ 0U }; j < vertexCount; ++j)
+	Vector3 minimum, maximum;
+	makeEmptyBounds(minimum, maximum);
+	switch (posElem->getType())
 	{
-		//Get pointer to the start of this vertex
-		posElem->baseVertexPointerToElement(vertex + j * vertexSize, &rawVertex);
-		mVertexBuffer[previousSize + j] = mTransform * Vector3{ rawVertex };
+	case VET_FLOAT3:
+		VertexKernels::transformFloat3(vertex + posElem->getOffset(), vertexSize, vertexCount, mTransform, mVertexBuffer.data() + previousSize, minimum, maximum);
+		break;
+	case VET_HALF4:
+		VertexKernels::transformHalf4(vertex + posElem->getOffset(), vertexSize, vertexCount, mTransform, mVertexBuffer.data() + previousSize, minimum, maximum);
+		break;
+	default:
+		log("Error: Vertex Buffer type not recognised");
 	}
 
 	//Release vertex buffer opened in read only
 	vbuf->unlock();
+
+	growBounds(minimum, maximum);
+	updateMemory();
 }
 
 void VertexIndexToShape::addAnimatedVertexData(const v1::VertexData *vertex_data,
@@ -71,7 +332,8 @@ void VertexIndexToShape::addAnimatedVertexData(const v1::VertexData *vertex_data
 	// Get the bone index element
 	assert(vertex_data);
 
-	const auto data = blend_data;
+	//Without software skinned data (meshes), the vertices are taken in the binding pose
+	const auto data = blend_data ? blend_data : vertex_data;
 
 	// Get current size;
 	const auto prev_size = mVertexBuffer.size();
@@ -88,38 +350,72 @@ void VertexIndexToShape::addAnimatedVertexData(const v1::VertexData *vertex_data
 
 	unsigned char* pBone;
 
-	if (!mBoneIndex)
-		mBoneIndex = new BoneIndex();
-	BoneIndex::iterator i;
-
-	///Todo : get rid of that
-	auto curVertices = &mVertexBuffer.data()[prev_size];
+	//Only the bone of each vertex is recorded here, buildBoneLayout() sorts them once everything is added
+	mVertexBones.resize(prev_size, noBone);
+	mVertexBones.reserve(mVertexBuffer.size());
 
 	const auto vertexCount = static_cast<unsigned int>(vertex_data->vertexCount);
 	for (auto j = size_t{ 0U }; j < vertexCount; ++j)
 	{
 		bneElem->baseVertexPointerToElement(vertex + j * vSize, &pBone);
+		mVertexBones.push_back(static_cast<uint16_t>(indexMap ? (*indexMap)[*pBone] : *pBone));
+	}
+	vbuf->unlock();
+	updateMemory();
+}
 
-		const auto currBone = static_cast<unsigned char>(indexMap ? (*indexMap)[*pBone] : *pBone);
-		i = mBoneIndex->find(currBone);
+void VertexIndexToShape::buildBoneLayout()
+{
+	const auto vertexCount = std::min(mVertexBones.size(), mVertexBuffer.size());
 
-		Vector3Array* l = nullptr;
+	//Count the vertices of each bone, one slot ahead so the prefix sum gives the start of each bone
+	mBoneOffsets.clear();
+	for (auto v = size_t{ 0 }; v < vertexCount; ++v)
+	{
+		const auto bone = mVertexBones[v];
+		if (bone == noBone) continue;
+		if (bone + size_t{ 2 } > mBoneOffsets.size())
+			mBoneOffsets.resize(bone + size_t{ 2 }, 0);
+		++mBoneOffsets[bone + 1];
+	}
+	if (mBoneOffsets.empty())
+		mBoneOffsets.push_back(0);
 
-		if (i == mBoneIndex->end())
-		{
-			l = new Vector3Array;
-			mBoneIndex->insert(BoneKeyIndex(currBone, l));
-		}
-		else
-		{
-			l = i->second;
-		}
+	for (auto b = size_t{ 1 }; b < mBoneOffsets.size(); ++b)
+		mBoneOffsets[b] += mBoneOffsets[b - 1];
 
-		l->push_back(*curVertices);
+	//Scatter the vertices to their bone's span, growing the bone bounds on the way
+	const auto boneCount = mBoneOffsets.size() - 1;
+	std::vector<size_t> cursors(mBoneOffsets.begin(), mBoneOffsets.end() - 1);
+	mBoneVertices.resize(mBoneOffsets.back());
+	mBoneBounds.resize(boneCount);
+	for (auto& bounds : mBoneBounds)
+		makeEmptyBounds(bounds.first, bounds.second);
 
-		curVertices++;
+	for (auto v = size_t{ 0 }; v < vertexCount; ++v)
+	{
+		const auto bone = mVertexBones[v];
+		if (bone == noBone) continue;
+
+		const auto& vertex = mVertexBuffer[v];
+		mBoneVertices[cursors[bone]++] = vertex;
+		mBoneBounds[bone].first.makeFloor(vertex);
+		mBoneBounds[bone].second.makeCeil(vertex);
 	}
-	vbuf->unlock();
+	updateMemory();
+}
+
+bool VertexIndexToShape::getBoneVertices(unsigned bone, const Vector3*& vertices, size_t& count) const
+{
+	if (bone + size_t{ 1 } >= mBoneOffsets.size())
+		return false;
+
+	count = mBoneOffsets[bone + 1] - mBoneOffsets[bone];
+	if (!count)
+		return false;
+
+	vertices = mBoneVertices.data() + mBoneOffsets[bone];
+	return true;
 }
 
 void VertexIndexToShape::appendV1IndexData(v1::IndexData *data, const size_t offset)
@@ -136,46 +432,77 @@ void VertexIndexToShape::appendV1IndexData(v1::IndexData *data, const size_t off
 		loadV1IndexBuffer<uint32_t>(ibuf, offset, previousSize, appendedIndexes);
 	else
 		loadV1IndexBuffer<uint16_t>(ibuf, offset, previousSize, appendedIndexes);
+
+	updateMemory();
 }
 
-Real VertexIndexToShape::getRadius()
+void VertexIndexToShape::resetBounds()
 {
-	if (mBoundRadius == -1)
+	makeEmptyBounds(mBoundsMinimum, mBoundsMaximum);
+}
+
+void VertexIndexToShape::recomputeBounds()
+{
+	resetBounds();
+	for (const auto& vertex : mVertexBuffer)
 	{
-		getSize();
-		mBoundRadius = std::max(mBounds.x, std::max(mBounds.y, mBounds.z)) * 0.5f;
+		mBoundsMinimum.makeFloor(vertex);
+		mBoundsMaximum.makeCeil(vertex);
 	}
-	return mBoundRadius;
 }
 
-Vector3 VertexIndexToShape::getCenterOffset()
+void VertexIndexToShape::growBounds(const Vector3& minimum, const Vector3& maximum)
 {
-	getSize();
-	return mCenter;
+	mBoundsMinimum.makeFloor(minimum);
+	mBoundsMaximum.makeCeil(maximum);
 }
 
-Vector3 VertexIndexToShape::getSize()
+void VertexIndexToShape::removeUnreferencedVertices(size_t firstVertex, size_t firstIndex)
 {
-	if (mBounds == Vector3(-1, -1, -1) && getVertexCount())
+	const auto noVertex = ~0u;
+	std::vector<unsigned> remap(mVertexBuffer.size() - firstVertex, noVertex);
+	for (auto i = firstIndex; i < mIndexBuffer.size(); ++i)
+		if (mIndexBuffer[i] >= firstVertex)
+			remap[mIndexBuffer[i] - firstVertex] = 0;
+
+	auto kept = firstVertex;
+	for (auto i = size_t{ 0 }; i < remap.size(); ++i)
 	{
-		auto vmin = mVertexBuffer[0];
-		auto vmax = vmin;
-
-		for (const auto vertex : mVertexBuffer)
-		{
-			vmin.x = std::min(vmin.x, vertex.x);
-			vmin.y = std::min(vmin.y, vertex.y);
-			vmin.z = std::min(vmin.z, vertex.z);
-			vmax.x = std::max(vmax.x, vertex.x);
-			vmax.y = std::max(vmax.y, vertex.y);
-			vmax.z = std::max(vmax.z, vertex.z);
-		}
+		if (remap[i] == noVertex) continue;
 
-		mBounds = vmax - vmin;
-		mCenter = vmin + mBounds/2;
+		remap[i] = static_cast<unsigned>(kept);
+		mVertexBuffer[kept++] = mVertexBuffer[firstVertex + i];
 	}
+	mVertexBuffer.resize(kept);
 
-	return mBounds;
+	for (auto i = firstIndex; i < mIndexBuffer.size(); ++i)
+		if (mIndexBuffer[i] >= firstVertex)
+			mIndexBuffer[i] = remap[mIndexBuffer[i] - firstVertex];
+
+	recomputeBounds();
+	updateMemory();
+}
+
+Real VertexIndexToShape::getRadius() const
+{
+	const auto size = getSize();
+	return std::max(size.x, std::max(size.y, size.z)) * 0.5f;
+}
+
+Vector3 VertexIndexToShape::getCenterOffset() const
+{
+	if (mBoundsMinimum.x > mBoundsMaximum.x)
+		return Vector3::ZERO;
+
+	return mBoundsMinimum.midPoint(mBoundsMaximum);
+}
+
+Vector3 VertexIndexToShape::getSize() const
+{
+	if (mBoundsMinimum.x > mBoundsMaximum.x)
+		return Vector3::ZERO;
+
+	return mBoundsMaximum - mBoundsMinimum;
 }
 
 //These should be const
@@ -203,6 +530,171 @@ size_t VertexIndexToShape::getTriangleCount() const
 	return getIndexCount() / 3;
 }
 
+WeldStatistics VertexIndexToShape::weldVertices(Real epsilon)
+{
+	WeldStatistics statistics;
+	statistics.verticesBefore = getVertexCount();
+	statistics.trianglesBefore = getTriangleCount();
+
+	//Cells are 4 epsilon wide: a vertex within epsilon of another one is in its cell, or in a neighbor if it's within
+	//epsilon of that side. So 8 cells are checked at most, and usually only one, whatever epsilon is
+	const auto exact = !(epsilon > 0);
+	const auto inverseCellSize = exact ? Real(0) : Real(0.25) / epsilon;
+	const auto squaredEpsilon = epsilon * epsilon;
+
+	const auto cellOf = [&](Real coordinate, Real& offset)
+	{
+		const auto scaled = coordinate * inverseCellSize;
+		const auto cell = std::floor(scaled);
+		offset = scaled - cell;
+		return static_cast<int64_t>(cell);
+	};
+
+	//Several cells can share a key, the chains are checked by distance anyway
+	const auto cellKey = [](int64_t x, int64_t y, int64_t z)
+	{
+		return uint64_t(x) * 73856093ULL ^ uint64_t(y) * 19349663ULL ^ uint64_t(z) * 83492791ULL;
+	};
+
+	const auto exactKey = [](const Vector3& v)
+	{
+		uint32_t bits[3];
+		for (auto i : { 0, 1, 2 })
+		{
+			//Make -0 and +0 the same
+			const float value = v[i] + 0.0f;
+			std::memcpy(&bits[i], &value, sizeof value);
+		}
+		return uint64_t(bits[0]) * 73856093ULL ^ uint64_t(bits[1]) * 19349663ULL ^ uint64_t(bits[2]) * 83492791ULL;
+	};
+
+	//Head of each cell's chain of kept vertices, and the chains
+	std::unordered_map<uint64_t, unsigned> cellHeads;
+	cellHeads.reserve(mVertexBuffer.size());
+	std::vector<unsigned> nextInCell;
+	nextInCell.reserve(mVertexBuffer.size());
+
+	std::vector<unsigned> remap(mVertexBuffer.size());
+	const auto noVertex = ~0u;
+	auto kept = 0u;
+
+	for (auto i = size_t{ 0 }; i < mVertexBuffer.size(); ++i)
+	{
+		const auto vertex = mVertexBuffer[i];
+		auto found = noVertex;
+
+		const auto search = [&](uint64_t key)
+		{
+			const auto head = cellHeads.find(key);
+			if (head == cellHeads.end()) return;
+
+			for (auto candidate = head->second; candidate != noVertex; candidate = nextInCell[candidate])
+			{
+				const auto matches = exact
+					? mVertexBuffer[candidate] == vertex
+					: mVertexBuffer[candidate].squaredDistance(vertex) <= squaredEpsilon;
+
+				//Keep the oldest match so the result doesn't depend on the chain order
+				if (matches && candidate < found)
+					found = candidate;
+			}
+		};
+
+		uint64_t key;
+		if (exact)
+		{
+			key = exactKey(vertex);
+			search(key);
+		}
+		else
+		{
+			Vector3 offset;
+			const int64_t cell[]{ cellOf(vertex.x, offset.x), cellOf(vertex.y, offset.y), cellOf(vertex.z, offset.z) };
+			const auto sideOf = [](Real o) { return o < 0.25f ? -1 : o > 0.75f ? 1 : 0; };
+			const int64_t side[]{ sideOf(offset.x), sideOf(offset.y), sideOf(offset.z) };
+
+			key = cellKey(cell[0], cell[1], cell[2]);
+			for (auto neighbor = 0; neighbor < 8; ++neighbor)
+			{
+				//Skip the combinations that use an axis with no neighbor to check
+				if (((neighbor & 1) && !side[0]) || ((neighbor & 2) && !side[1]) || ((neighbor & 4) && !side[2]))
+					continue;
+
+				search(cellKey(cell[0] + ((neighbor & 1) ? side[0] : 0),
+					cell[1] + ((neighbor & 2) ? side[1] : 0),
+					cell[2] + ((neighbor & 4) ? side[2] : 0)));
+			}
+		}
+
+		if (found != noVertex)
+		{
+			remap[i] = found;
+			continue;
+		}
+
+		//Kept vertices are compacted in place, before any vertex that's still to be read
+		mVertexBuffer[kept] = vertex;
+		remap[i] = kept;
+
+		const auto head = cellHeads.emplace(key, kept);
+		nextInCell.push_back(head.second ? noVertex : head.first->second);
+		head.first->second = kept;
+
+		++kept;
+	}
+
+	mVertexBuffer.resize(kept);
+
+	//Remap the triangles and drop the ones that don't have an area anymore
+	auto triangles = size_t{ 0 };
+	for (auto i = size_t{ 0 }; i + 2 < mIndexBuffer.size(); i += 3)
+	{
+		const auto a = remap[mIndexBuffer[i]];
+		const auto b = remap[mIndexBuffer[i + 1]];
+		const auto c = remap[mIndexBuffer[i + 2]];
+
+		if (a == b || b == c || c == a)
+			continue;
+
+		const auto normal = (mVertexBuffer[b] - mVertexBuffer[a]).crossProduct(mVertexBuffer[c] - mVertexBuffer[a]);
+		if (normal.squaredLength() == 0)
+			continue;
+
+		mIndexBuffer[3 * triangles] = a;
+		mIndexBuffer[3 * triangles + 1] = b;
+		mIndexBuffer[3 * triangles + 2] = c;
+		++triangles;
+	}
+	mIndexBuffer.resize(3 * triangles);
+
+	//Kept vertices are a subset of the old ones, the bounds may have shrunk by up to epsilon
+	recomputeBounds();
+
+	statistics.verticesAfter = getVertexCount();
+	statistics.trianglesAfter = getTriangleCount();
+
+	log("weldVertices : " + std::to_string(statistics.verticesBefore) + " -> " + std::to_string(statistics.verticesAfter)
+		+ " vertices, " + std::to_string(statistics.trianglesBefore) + " -> " + std::to_string(statistics.trianglesAfter) + " triangles");
+
+	return statistics;
+}
+
+SimplifyStatistics VertexIndexToShape::simplify(size_t targetTriangles, Real maxError, bool preserveBorders)
+{
+	MeshSimplifier simplifier(targetTriangles, maxError);
+	simplifier.setPreserveBorders(preserveBorders);
+	const auto statistics = simplifier.simplify(mVertexBuffer, mIndexBuffer);
+
+	recomputeBounds();
+	updateMemory();
+
+	log("simplify : " + std::to_string(statistics.verticesBefore) + " -> " + std::to_string(statistics.verticesAfter)
+		+ " vertices, " + std::to_string(statistics.trianglesBefore) + " -> " + std::to_string(statistics.trianglesAfter)
+		+ " triangles, error " + std::to_string(statistics.error));
+
+	return statistics;
+}
+
 btSphereShape* VertexIndexToShape::createSphere()
 {
 	const auto rad = getRadius();
@@ -212,7 +704,7 @@ btSphereShape* VertexIndexToShape::createSphere()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
 }
 
 btBoxShape* VertexIndexToShape::createBox()
@@ -226,7 +718,7 @@ btBoxShape* VertexIndexToShape::createBox()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
 }
 
 btCylinderShape* VertexIndexToShape::createCylinder()
@@ -252,7 +744,7 @@ btCylinderShape* VertexIndexToShape::createCylinder()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
 }
 btConvexHullShape* VertexIndexToShape::createConvex()
 {
@@ -263,7 +755,81 @@ btConvexHullShape* VertexIndexToShape::createConvex()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
+}
+
+btConvexHullShape* VertexIndexToShape::createReducedConvex(unsigned vertexBudget, Real maxError, Real* error) const
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	return recordShape(ConvexHullBuilder(vertexBudget, maxError).build(mVertexBuffer.data(), getVertexCount(), Convert::toBullet(mScale), error));
+}
+
+btCompoundShape* VertexIndexToShape::createConvexDecomposition(const ConvexDecompositionSettings& settings) const
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	return recordShape(ConvexDecomposition(settings).build(mVertexBuffer.data(), getVertexCount(), mIndexBuffer.data(), getIndexCount(),
+		Convert::toBullet(mScale), mThreadPool));
+}
+
+QuantizedBvhTriangleMeshShape* VertexIndexToShape::createQuantizedTrimesh(unsigned maxChunkTriangles, bool compareWithFloat) const
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	auto shape = new QuantizedBvhTriangleMeshShape(mVertexBuffer.data(), getVertexCount(), mIndexBuffer.data(), getIndexCount(),
+		Convert::toBullet(mScale), maxChunkTriangles);
+
+	const auto& mesh = shape->getQuantizedMesh();
+	const auto memory = MemoryStats::measureShape(shape);
+	log("createQuantizedTrimesh : " + std::to_string(mesh.getNumSubParts()) + " chunks, " + std::to_string(memory.getTotal())
+		+ " bytes, max error " + std::to_string(mesh.getMaxError()));
+
+	if (compareWithFloat)
+	{
+		//What createOwningTrimesh() would give, on copies of the buffers, queried with the same boxes
+		const OwningBvhTriangleMeshShape reference(VertexBuffer(mVertexBuffer), IndexBuffer(mIndexBuffer), Convert::toBullet(mScale));
+		const auto referenceMemory = MemoryStats::measureShape(&reference);
+		const auto throughput = QueryBenchmark::measure(shape);
+		const auto referenceThroughput = QueryBenchmark::measure(&reference);
+
+		log("createQuantizedTrimesh : " + std::to_string(memory.getTotal()) + " bytes (mesh " + std::to_string(memory.meshData)
+			+ ", BVH " + std::to_string(memory.bvh) + ") instead of " + std::to_string(referenceMemory.getTotal()) + " (mesh "
+			+ std::to_string(referenceMemory.meshData) + ", BVH " + std::to_string(referenceMemory.bvh) + ") as floats, "
+			+ std::to_string(throughput.queriesPerSecond) + " queries/s instead of " + std::to_string(referenceThroughput.queriesPerSecond));
+	}
+
+	return recordShape(shape);
+}
+
+TiledTrimeshShape* VertexIndexToShape::createTiledTrimesh(const TilingSettings& settings) const
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	auto shape = new TiledTrimeshShape(settings, mScale);
+	shape->build(mVertexBuffer.data(), getVertexCount(), mIndexBuffer.data(), getIndexCount(), mThreadPool);
+
+	log("createTiledTrimesh : " + std::to_string(getTriangleCount()) + " triangles in " + std::to_string(shape->getNumChildShapes()) + " tiles");
+	return recordShape(shape);
+}
+
+OwningHeightfieldTerrainShape* VertexIndexToShape::createHeightfield(Vector3& originOffset, Real tolerance) const
+{
+	HeightfieldGrid grid;
+	if (!Heightfield::detectGrid(mVertexBuffer.data(), getVertexCount(), mIndexBuffer.data(), getIndexCount(), grid, tolerance))
+	{
+		log("createHeightfield : the mesh isn't a regular grid in the XZ plane");
+		return nullptr;
+	}
+
+	//Same as setting the local scaling of the other shapes
+	grid.spacing *= mScale;
+	grid.corner *= mScale;
+	return recordShape(Heightfield::create(std::move(grid), originOffset));
 }
 
 btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh()
@@ -271,8 +837,10 @@ btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh()
 	assert(getVertexCount() && (getIndexCount() >= 6) &&
 		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
 
+	//btTriangleMesh doesn't share vertices between the triangles added here, 16 bits indices are enough below 65536 of them
 	const auto numFaces = getTriangleCount();
-	auto trimesh = new btTriangleMesh();
+	const auto use32bitIndices = 3 * numFaces > size_t{ std::numeric_limits<uint16_t>::max() } + 1;
+	auto trimesh = new btTriangleMesh(use32bitIndices);
 
 	btVector3 vertexPos[3];
 	for (auto i = size_t{ 0U }; i < numFaces; ++i)
@@ -288,7 +856,56 @@ btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
+}
+
+OwningBvhTriangleMeshShape* VertexIndexToShape::createOwningTrimesh()
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	//Scaling is given up front, so the BVH isn't built a second time by setLocalScaling
+	auto shape = new OwningBvhTriangleMeshShape(std::move(mVertexBuffer), std::move(mIndexBuffer), Convert::toBullet(mScale));
+
+	//The buffers now belong to the shape, leave this converter in a clean empty state
+	mVertexBuffer.clear();
+	mIndexBuffer.clear();
+	resetBounds();
+	updateMemory();
+
+	return recordShape(shape);
+}
+
+OwningBvhTriangleMeshShape* VertexIndexToShape::createCachedTrimesh(BvhCache& cache, const std::string& name, bool internalEdgeInfo)
+{
+	assert(getVertexCount() && (getIndexCount() >= 6) &&
+		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
+
+	auto shape = cache.createTrimesh(std::move(mVertexBuffer), std::move(mIndexBuffer), Convert::toBullet(mScale), name, internalEdgeInfo);
+
+	mVertexBuffer.clear();
+	mIndexBuffer.clear();
+	resetBounds();
+	updateMemory();
+
+	return recordShape(shape);
+}
+
+btCollisionShape* VertexIndexToShape::createShape(ShapeKind kind)
+{
+	switch (kind)
+	{
+	case ShapeKind::Sphere: return createSphere();
+	case ShapeKind::Box: return createBox();
+	case ShapeKind::Cylinder: return createCylinder();
+	case ShapeKind::Capsule: return createCapsule();
+	case ShapeKind::Convex: return createConvex();
+	case ShapeKind::Trimesh: return createOwningTrimesh();
+	case ShapeKind::ConvexDecomposition: return createConvexDecomposition();
+	case ShapeKind::Skeleton: break;
+	}
+
+	return nullptr;
 }
 
 btCapsuleShape* VertexIndexToShape::createCapsule()
@@ -320,28 +937,156 @@ btCapsuleShape* VertexIndexToShape::createCapsule()
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
-	return shape;
+	return recordShape(shape);
 }
 
-VertexIndexToShape::~VertexIndexToShape()
+btBoxShape* VertexIndexToShape::createFittedBox(btTransform& transform) const
 {
-	if (mBoneIndex)
+	assert(getVertexCount() && ("Mesh must have some vertices"));
+
+	OrientedBox box;
+	if (mScale == Vector3::UNIT_SCALE)
+	{
+		box = OrientedBoxFitter::fit(mVertexBuffer.data(), getVertexCount());
+	}
+	else
+	{
+		//A non uniform scale changes the best orientation, fit the scaled vertices
+		auto points = mVertexBuffer;
+		for (auto& point : points)
+			point *= mScale;
+		box = OrientedBoxFitter::fit(points.data(), points.size());
+	}
+
+	transform = box.getTransform();
+	return recordShape(box.createShape());
+}
+
+btCollisionShape* VertexIndexToShape::createBestFit(Real tolerance, btTransform& transform, BestFitReport* report) const
+{
+	assert(getVertexCount() >= 4 && ("Mesh must have at least 4 vertices"));
+
+	//A non uniform scale changes which primitive fits best, fit the scaled vertices
+	VertexBuffer scaled;
+	if (mScale != Vector3::UNIT_SCALE)
+	{
+		scaled = mVertexBuffer;
+		for (auto& point : scaled)
+			point *= mScale;
+	}
+	const auto& points = scaled.empty() ? mVertexBuffer : scaled;
+
+	//Only the hull can touch the candidates, they're fitted to its vertices
+	const auto hull = ConvexHullBuilder(std::numeric_limits<unsigned>::max()).computeHull(points.data(), points.size());
+	const auto& fitted = hull.size() >= 4 ? hull : points;
+	const auto hullVolume = getHullVolume(fitted.data(), fitted.size());
+
+	struct Candidate
+	{
+		PrimitiveFit fit;
+		btCollisionShape* shape;
+		btTransform transform;
+	};
+	std::vector<Candidate> candidates;
+	const auto addCandidate = [&](ShapeKind kind, bool oriented, btCollisionShape* shape, const btTransform& shapeTransform, Real volume)
+	{
+		if (!shape) return;
+		candidates.push_back({ { kind, oriented, hullVolume > 0 ? volume / hullVolume : std::numeric_limits<Real>::infinity() }, shape, shapeTransform });
+	};
+
+	auto minimum = fitted[0], maximum = fitted[0];
+	for (const auto& point : fitted)
+	{
+		minimum.makeFloor(point);
+		maximum.makeCeil(point);
+	}
+	const auto center = minimum.midPoint(maximum);
+	const auto size = maximum - minimum;
+	const btTransform centered(btQuaternion::getIdentity(), Convert::toBullet(center));
+
+	//Sphere around the center of the AABB
+	auto radius = Real(0);
+	for (const auto& point : fitted)
+		radius = std::max(radius, point.squaredDistance(center));
+	radius = std::sqrt(radius);
+	addCandidate(ShapeKind::Sphere, false, radius > 0 ? new btSphereShape(radius) : nullptr, centered, 4 * Math::PI * radius * radius * radius / 3);
+
+	//Capsules and cylinders go along the longest axis of the fitted box
+	const auto box = OrientedBoxFitter::fit(fitted.data(), fitted.size());
+	const auto boxTransform = box.getTransform();
+	const auto toBox = box.orientation.Inverse();
+	VertexBuffer boxPoints(fitted.size());
+	for (auto i = size_t{ 0 }; i < fitted.size(); ++i)
+		boxPoints[i] = toBox * (fitted[i] - box.center);
+
+	btTransform offset;
+	if (const auto capsule = static_cast<btCapsuleShape*>(BoneShapeFitter::fit(BonePrimitive::Capsule, boxPoints.data(), boxPoints.size(), 0, offset)))
+	{
+		const auto r = Real(capsule->getRadius());
+		addCandidate(ShapeKind::Capsule, true, capsule, boxTransform * offset,
+			Math::PI * r * r * 2 * Real(capsule->getHalfHeight()) + 4 * Math::PI * r * r * r / 3);
+	}
+
+	addCandidate(ShapeKind::Box, false, size.x > 0 && size.y > 0 && size.z > 0 ? new btBoxShape(Convert::toBullet(0.5f * size)) : nullptr,
+		centered, size.x * size.y * size.z);
+	addCandidate(ShapeKind::Box, true, box.getVolume() > 0 ? box.createShape() : nullptr, boxTransform, box.getVolume());
+
+	if (const auto cylinder = static_cast<btCylinderShape*>(BoneShapeFitter::fit(BonePrimitive::Cylinder, boxPoints.data(), boxPoints.size(), 0, offset)))
 	{
-		for (auto i = begin(*mBoneIndex);
-			i != end(*mBoneIndex);
-			++i)
-			delete i->second;
-		delete mBoneIndex;
+		const auto r = Real(cylinder->getRadius());
+		const auto halfHeight = Real(cylinder->getHalfExtentsWithMargin()[cylinder->getUpAxis()]);
+		addCandidate(ShapeKind::Cylinder, true, cylinder, boxTransform * offset, Math::PI * r * r * 2 * halfHeight);
 	}
+
+	//The fallback, always kept
+	const auto convex = ConvexHullBuilder().build(points.data(), points.size());
+	std::vector<Vector3> convexPoints(static_cast<size_t>(convex->getNumPoints()));
+	for (auto i = 0; i < convex->getNumPoints(); ++i)
+		convexPoints[size_t(i)] = Convert::toOgre(convex->getUnscaledPoints()[i]);
+	candidates.push_back({ { ShapeKind::Convex, false, hullVolume > 0 ? getHullVolume(convexPoints.data(), convexPoints.size()) / hullVolume : 1 },
+		convex, btTransform::getIdentity() });
+
+	//The cheapest one within tolerance wins, the others are deleted
+	auto picked = candidates.size() - 1;
+	for (auto i = size_t{ 0 }; i < candidates.size() - 1; ++i)
+	{
+		if (candidates[i].fit.volumeRatio <= 1 + tolerance)
+		{
+			picked = i;
+			break;
+		}
+	}
+
+	std::string fits;
+	for (auto i = size_t{ 0 }; i < candidates.size(); ++i)
+	{
+		fits += (i ? ", " : "") + getFitName(candidates[i].fit) + " " + std::to_string(candidates[i].fit.volumeRatio);
+		if (i != picked)
+			delete candidates[i].shape;
+	}
+	log("createBestFit : " + fits + " -> " + getFitName(candidates[picked].fit));
+
+	if (report)
+	{
+		report->hullVolume = hullVolume;
+		report->candidates.clear();
+		for (const auto& candidate : candidates)
+			report->candidates.push_back(candidate.fit);
+		report->picked = picked;
+	}
+
+	transform = candidates[picked].transform;
+	return recordShape(candidates[picked].shape);
 }
 
+const uint16_t VertexIndexToShape::noBone;
+
 VertexIndexToShape::VertexIndexToShape(const Matrix4 &transform) :
-	mBounds(Vector3(-1, -1, -1)),
-	mBoundRadius(-1),
-	mBoneIndex(nullptr),
 	mTransform(transform),
-	mScale(1)
+	mScale(1),
+	mThreadPool(&ThreadPool::getSingleton())
 {
+	resetBounds();
 }
 
 /*
@@ -358,27 +1103,31 @@ StaticMeshToShapeConverter::StaticMeshToShapeConverter() :
 {
 }
 
-StaticMeshToShapeConverter::StaticMeshToShapeConverter(v1::Entity *entity, const Matrix4 &transform) :
+StaticMeshToShapeConverter::StaticMeshToShapeConverter(v1::Entity *entity, const Matrix4 &transform, const MeshLod& lod) :
 	VertexIndexToShape(transform),
 	mEntity(nullptr),
 	mItem(nullptr),
 	mNode(nullptr)
 {
-	addEntity(entity, transform);
+	addEntity(entity, transform, lod);
 }
 
-StaticMeshToShapeConverter::StaticMeshToShapeConverter(v1::Mesh *mesh, const Matrix4 &transform) :
+StaticMeshToShapeConverter::StaticMeshToShapeConverter(v1::Mesh *mesh, const Matrix4 &transform, const MeshLod& lod) :
 	VertexIndexToShape(transform),
 	mEntity(nullptr),
 	mItem(nullptr),
 	mNode(nullptr)
 {
-	addMesh(mesh, transform);
+	addMesh(mesh, transform, lod);
 }
 
-StaticMeshToShapeConverter::StaticMeshToShapeConverter(Item* item, const Matrix4& transform)
+StaticMeshToShapeConverter::StaticMeshToShapeConverter(Item* item, const Matrix4& transform, const MeshLod& lod) :
+	VertexIndexToShape(transform),
+	mEntity(nullptr),
+	mItem(nullptr),
+	mNode(nullptr)
 {
-	addItem(item, transform);
+	addItem(item, transform, lod);
 }
 
 StaticMeshToShapeConverter::StaticMeshToShapeConverter(Renderable *rend, const Matrix4 &transform) :
@@ -394,27 +1143,26 @@ StaticMeshToShapeConverter::StaticMeshToShapeConverter(Renderable *rend, const M
 		appendV1IndexData(op.indexData);
 }
 
-void StaticMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &transform)
+void StaticMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &transform, const MeshLod& lod)
 {
 	mEntity = entity;
 	mNode = static_cast<SceneNode*>(mEntity->getParentNode());
 	mScale = mNode ? mNode->getScale() : Vector3::UNIT_SCALE;
 
-	addMesh(mEntity->getMesh().get(), transform);
+	addMesh(mEntity->getMesh().get(), transform, lod);
 }
 
-void StaticMeshToShapeConverter::addMesh(const v1::Mesh *mesh, const Matrix4 &transform)
+void StaticMeshToShapeConverter::addMesh(const v1::Mesh *mesh, const Matrix4 &transform, const MeshLod& lod)
 {
-	// Each entity added need to reset size and radius
-	// next time getRadius and getSize are asked, they will be computed.
-	mBounds = Vector3(-1, -1, -1);
-	mBoundRadius = -1;
-
 	mTransform = transform;
 
 	if (mesh->hasSkeleton())
 		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
 
+	const auto level = lod.resolve(mesh);
+	const auto firstVertex = getVertexCount();
+	const auto firstIndex = getIndexCount();
+
 	if (mesh->sharedVertexData[0])
 	{
 		appendV1VertexData(mesh->sharedVertexData[0]);
@@ -426,148 +1174,270 @@ void StaticMeshToShapeConverter::addMesh(const v1::Mesh *mesh, const Matrix4 &tr
 
 		if (!sub_mesh->useSharedVertices)
 		{
-			appendV1IndexData(sub_mesh->indexData[0], getVertexCount());
+			appendV1IndexData(getV1LodIndexData(sub_mesh, level), getVertexCount());
 			appendV1VertexData(sub_mesh->vertexData[0]);
 		}
 		else
 		{
-			appendV1IndexData(sub_mesh->indexData[0]);
+			appendV1IndexData(getV1LodIndexData(sub_mesh, level));
 		}
 	}
+
+	if (level > 0)
+		removeUnreferencedVertices(firstVertex, firstIndex);
 }
 
-void VertexIndexToShape::getV2MeshBufferSize(const Mesh* mesh, size_t& previousVertexSize, size_t& previousIndexSize)
+void VertexIndexToShape::requestV2SubMeshes(const Mesh* mesh, std::vector<V2SubMeshReadback>& subMeshes, unsigned short lodLevel)
 {
-	size_t numVertices = 0U;
-	size_t numIndices = 0U;
-
-	previousVertexSize = mVertexBuffer.size();
-	previousIndexSize = mVertexBuffer.size();
+	auto vertexDestination = mVertexBuffer.size();
+	auto indexDestination = mIndexBuffer.size();
 
+	subMeshes.reserve(subMeshes.size() + mesh->getSubMeshes().size());
 	for (const auto subMesh : mesh->getSubMeshes())
 	{
-		numVertices += subMesh->mVao[0][0]->getVertexBuffers()[0]->getNumElements();
-		numIndices += subMesh->mVao[0][0]->getIndexBuffer()->getNumElements();
+		//Get VAO, go to next if submesh empty
+		const auto& vaos = subMesh->mVao[0];
+		if (vaos.empty()) continue;
+
+		//Get the requested LOD level, or the nearest one this submesh has
+		V2SubMeshReadback readback;
+		readback.vao = vaos[std::min<size_t>(lodLevel, vaos.size() - 1)];
+		readback.indexBuffer = readback.vao->getIndexBuffer();
+		readback.indexData = nullptr;
+		readback.indices32 = readback.indexBuffer && readback.indexBuffer->getIndexType() == IndexBufferPacked::IT_32BIT;
+		readback.vertexCount = readback.vao->getVertexBuffers()[0]->getNumElements();
+		readback.indexCount = readback.indexBuffer ? readback.indexBuffer->getNumElements() : 0;
+		readback.vertexDestination = vertexDestination;
+		readback.indexDestination = indexDestination;
+
+		vertexDestination += readback.vertexCount;
+		indexDestination += readback.indexCount;
+
+		//Send every request to the VAO manager before waiting on any of them
+		readback.requests.push_back(VertexArrayObject::ReadRequests(VES_POSITION));
+		readback.vao->readRequests(readback.requests);
+
+		if (readback.indexCount)
+			readback.indexTicket = readback.indexBuffer->readRequest(0, readback.indexCount);
+
+		subMeshes.push_back(std::move(readback));
 	}
 
-	mVertexBuffer.resize(mVertexBuffer.size() + numVertices);
-	mIndexBuffer.resize(mIndexBuffer.size() + numIndices);
+	//This will extend the vertex/index buffers to fit the data
+	mVertexBuffer.resize(vertexDestination);
+	mIndexBuffer.resize(indexDestination);
+	updateMemory();
 }
 
-void VertexIndexToShape::extractV2SubMeshVertexBuffer(size_t& subMeshOffset,
-	OGRE_VertexArrayObject_ReadRequests requests,
-	const size_t& prevSize)
+bool VertexIndexToShape::isV2ReadbackDone(const std::vector<V2SubMeshReadback>& subMeshes)
 {
-	auto subMeshVerticiesNum = requests[0].vertexBuffer->getNumElements();
-	switch (requests[0].type)
+	for (const auto& subMesh : subMeshes)
 	{
-	case VET_HALF4:
-		for (size_t i = 0; i < subMeshVerticiesNum; ++i)
+		for (const auto& request : subMesh.requests)
+			if (!request.asyncTicket->queryIsTransferDone())
+				return false;
+
+		if (subMesh.indexCount && !subMesh.indexTicket->queryIsTransferDone())
+			return false;
+	}
+
+	return true;
+}
+
+void VertexIndexToShape::mapV2SubMeshes(std::vector<V2SubMeshReadback>& subMeshes)
+{
+	for (auto& subMesh : subMeshes)
+	{
+		subMesh.vao->mapAsyncTickets(subMesh.requests);
+
+		if (subMesh.indexCount)
+			subMesh.indexData = subMesh.indexTicket->map();
+	}
+}
+
+void VertexIndexToShape::decodeV2SubMesh(V2SubMeshReadback& subMesh)
+{
+	makeEmptyBounds(subMesh.minimum, subMesh.maximum);
+	extractV2SubMeshVertexBuffer(subMesh.vertexDestination, subMesh.requests[0], subMesh.minimum, subMesh.maximum);
+
+	if (!subMesh.indexData) return;
+
+	//Indices are relative to the submesh's vertex buffer, rebase them to where we wrote its vertices
+	if (subMesh.indices32)
+		loadV2IndexBuffer(static_cast<const uint32*>(subMesh.indexData), subMesh.vertexDestination, subMesh.indexDestination, subMesh.indexCount);
+	else
+		loadV2IndexBuffer(static_cast<const uint16*>(subMesh.indexData), subMesh.vertexDestination, subMesh.indexDestination, subMesh.indexCount);
+}
+
+void VertexIndexToShape::releaseV2SubMeshes(std::vector<V2SubMeshReadback>& subMeshes)
+{
+	for (auto& subMesh : subMeshes)
+	{
+		//Submeshes that weren't mapped, when mapping failed before them, only free their tickets with the requests
+		if (!subMesh.requests.empty() && subMesh.requests.front().data)
+			subMesh.vao->unmapAsyncTickets(subMesh.requests);
+
+		if (subMesh.indexData)
 		{
-			auto pos = reinterpret_cast<const uint16*>(requests[0].data);	//Stored as 16 bits. Need to use Ogre::Bitwise utilities to extract a floating point form this
-			requests[0].data += requests[0].vertexBuffer->getBytesPerElement();
-			mVertexBuffer[prevSize + i + subMeshOffset] = mTransform * Vector3{ Bitwise::halfToFloat(pos[0]), Bitwise::halfToFloat(pos[1]), Bitwise::halfToFloat(pos[2]) };
+			subMesh.indexTicket->unmap();
+			subMesh.indexData = nullptr;
 		}
+	}
+}
+
+void VertexIndexToShape::extractV2SubMeshVertexBuffer(size_t destination, const VertexArrayObject::ReadRequests& request,
+	Vector3& minimum, Vector3& maximum)
+{
+	const auto subMeshVerticiesNum = request.vertexBuffer->getNumElements();
+	const auto stride = request.vertexBuffer->getBytesPerElement();
+	const auto data = reinterpret_cast<const unsigned char*>(request.data);
+
+	switch (request.type)
+	{
+	case VET_HALF4:
+		VertexKernels::transformHalf4(data, stride, subMeshVerticiesNum, mTransform, mVertexBuffer.data() + destination, minimum, maximum);
 		break;
 	case VET_FLOAT3:
-		for (size_t i = 0; i < subMeshVerticiesNum; ++i)
-		{
-			auto pos = reinterpret_cast<const Real*>(requests[0].data);
-			requests[0].data += requests[0].vertexBuffer->getBytesPerElement();
-			mVertexBuffer[prevSize + i + subMeshOffset] = mTransform * Vector3(pos);
-		}
+		VertexKernels::transformFloat3(data, stride, subMeshVerticiesNum, mTransform, mVertexBuffer.data() + destination, minimum, maximum);
 		break;
 	default:
 		log("Error: Vertex Buffer type not recognised");
 	}
-	subMeshOffset += subMeshVerticiesNum;
 }
 
-void VertexIndexToShape::requestV2VertexBufferFromVao(VertexArrayObject* vao, OGRE_VertexArrayObject_ReadRequests& requests)
+void VertexIndexToShape::setThreadPool(ThreadPool* pool)
 {
-	requests.push_back(VertexArrayObject::ReadRequests(VES_POSITION));
+	mThreadPool = pool;
+}
 
-	vao->readRequests(requests);
-	vao->mapAsyncTickets(requests);
+void VertexIndexToShape::setScale(const Vector3& scale)
+{
+	mScale = scale;
 }
 
-void VertexIndexToShape::extractV2SubMeshIndexBuffer(const size_t& previousSize, const size_t& offset, const bool& indices32, IndexBufferPacked* indexBuffer)
+ConverterMemoryStats VertexIndexToShape::getMemoryStats() const
 {
-	if (indexBuffer)
-	{
-		auto asyncTicket = indexBuffer->readRequest(0, indexBuffer->getNumElements());
+	ConverterMemoryStats stats;
+	stats.vertexBuffer = mVertexBuffer.capacity() * sizeof(Vector3);
+	stats.indexBuffer = mIndexBuffer.capacity() * sizeof(unsigned);
+	stats.boneLayout = mVertexBones.capacity() * sizeof(uint16_t) + mBoneVertices.capacity() * sizeof(Vector3)
+		+ mBoneOffsets.capacity() * sizeof(size_t) + mBoneBounds.capacity() * sizeof(BoneBounds::value_type);
+	stats.peak = mMemory.getPeak();
+	stats.shapeCount = mMemory.getShapeCount();
+	stats.shapeMemory = mMemory.getShapeMemory();
+	return stats;
+}
 
-		if (indices32) loadV2IndexBuffer<uint32>(asyncTicket, offset, previousSize, indexBuffer->getNumElements());
-		else loadV2IndexBuffer<uint16>(asyncTicket, offset, previousSize, indexBuffer->getNumElements());
+void VertexIndexToShape::resetMemoryPeak()
+{
+	mMemory.resetPeak();
+}
+
+void VertexIndexToShape::updateMemory()
+{
+	mMemory.setBufferMemory(getMemoryStats().getBufferMemory());
+}
+
+void VertexIndexToShape::merge(const VertexIndexToShape& other)
+{
+	const auto firstVertex = unsigned(mVertexBuffer.size());
+
+	//The other vertices are already transformed, but their scale belongs to the mesh, before the transform:
+	//T * (S * v) = (T * S * T^-1) * (T * v). This converter's scale is applied to the shape later, so it's divided out
+	const auto toMerged = Matrix4::getScale(Vector3::UNIT_SCALE / mScale) * other.mTransform
+		* Matrix4::getScale(other.mScale) * other.mTransform.inverse();
+
+	Vector3 minimum, maximum;
+	makeEmptyBounds(minimum, maximum);
+
+	mVertexBuffer.reserve(mVertexBuffer.size() + other.mVertexBuffer.size());
+	for (const auto& vertex : other.mVertexBuffer)
+	{
+		mVertexBuffer.push_back(toMerged * vertex);
+		minimum.makeFloor(mVertexBuffer.back());
+		maximum.makeCeil(mVertexBuffer.back());
 	}
+
+	mIndexBuffer.reserve(mIndexBuffer.size() + other.mIndexBuffer.size());
+	for (const auto index : other.mIndexBuffer)
+		mIndexBuffer.push_back(index + firstVertex);
+
+	growBounds(minimum, maximum);
+	updateMemory();
 }
 
-void StaticMeshToShapeConverter::addItem(Item* item, const Matrix4& transform)
+void StaticMeshToShapeConverter::addItem(Item* item, const Matrix4& transform, const MeshLod& lod)
 {
 	mItem = item;
 	mNode = static_cast<SceneNode*>(mItem->getParentNode());
 	mScale = mNode ? mNode->getScale() : Vector3::UNIT_SCALE;
 
-	addMesh(item->getMesh().get(), transform);
+	addMesh(item->getMesh().get(), transform, lod);
 }
 
-void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transform)
+void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transform, const MeshLod& lod)
 {
-	mBounds = Vector3{ -1, -1, -1 };
-	mBoundRadius = -1;
-	mTransform = transform;
-
-	if (mesh->hasSkeleton())
-		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
-
-	//Theses variables will hold the current size of this buffer
-	size_t prevVertexSize;
-	size_t prevIndexSize;
-	size_t appendedIndexes = 0;
+	//Read everything back from the GPU at once. This has to happen on the thread that owns the VaoManager
+	requestMesh(mesh, transform, lod);
+	mapReadback();
+	decodeReadback();
+	releaseReadback();
+}
 
-	//This will extend the vertex/index buffers to fit the data
-	getV2MeshBufferSize(mesh, prevVertexSize, prevIndexSize);
+void StaticMeshToShapeConverter::requestItem(Item* item, const Matrix4& transform, const MeshLod& lod)
+{
+	mItem = item;
+	mNode = static_cast<SceneNode*>(mItem->getParentNode());
+	mScale = mNode ? mNode->getScale() : Vector3::UNIT_SCALE;
 
-	//The number to offset the index values. When switching submeshes, we want to append the indexes when reconstructing the full thing.
-	auto indexOffset = mIndexBuffer.empty() ? 0U : mIndexBuffer[mIndexBuffer.size() - 1];
+	requestMesh(item->getMesh().get(), transform, lod);
+}
 
-	//The offset associated with the current submesh
-	size_t subMeshOffset = 0U;
+void StaticMeshToShapeConverter::requestMesh(const Mesh* mesh, const Matrix4& transform, const MeshLod& lod)
+{
+	assert(mReadback.empty() && "The previous readback must be released first");
+	mTransform = transform;
 
-	//For each submeshes
-	for (const auto& subMesh : mesh->getSubMeshes())
-	{
-		//Get VAO, go to next if submesh empty
-		const auto vaos = subMesh->mVao[0];
-		if (vaos.empty()) continue;
+	if (mesh->hasSkeleton())
+		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
 
-		//Get the first LOD level
-		const auto vao = vaos[0];
+	mReadbackLevel = lod.resolve(mesh);
+	mReadbackFirstVertex = getVertexCount();
+	mReadbackFirstIndex = getIndexCount();
+	requestV2SubMeshes(mesh, mReadback, mReadbackLevel);
+}
 
-		//Get the packed buffer information
-		const auto& vertexBuffers = vao->getVertexBuffers();
-		const auto indexBuffer = vao->getIndexBuffer();
+bool StaticMeshToShapeConverter::isReadbackDone() const
+{
+	return isV2ReadbackDone(mReadback);
+}
 
-		//request async read from buffer
-		OGRE_VertexArrayObject_ReadRequests requests;
-		requestV2VertexBufferFromVao(vao, requests);	// /!\ Don't forget that this call will map async tickets in the request
+void StaticMeshToShapeConverter::mapReadback()
+{
+	mapV2SubMeshes(mReadback);
+}
 
-		//Load the requested data into vertex buffer, this will map the tickets.
-		extractV2SubMeshVertexBuffer(subMeshOffset, requests, prevVertexSize);
+void StaticMeshToShapeConverter::decodeReadback()
+{
+	//Each submesh writes to its own slice of the buffers, decode them in parallel
+	const auto decode = [&](size_t i) { decodeV2SubMesh(mReadback[i]); };
+	if (mThreadPool)
+		mThreadPool->parallelFor(mReadback.size(), decode);
+	else
+		for (size_t i = 0; i < mReadback.size(); ++i) decode(i);
 
-		//Don't need that request anymore, unmap all tickets
-		vao->unmapAsyncTickets(requests);
+	for (const auto& subMesh : mReadback)
+		growBounds(subMesh.minimum, subMesh.maximum);
 
-		//Read index data
-		extractV2SubMeshIndexBuffer(prevIndexSize + appendedIndexes,
-			indexOffset,
-			vao->getIndexBuffer()->getIndexType() == IndexBufferPacked::IT_32BIT,
-			indexBuffer);
+	if (mReadbackLevel > 0)
+		removeUnreferencedVertices(mReadbackFirstVertex, mReadbackFirstIndex);
+}
 
-		//offset the index values by the number of vertex we got from that VAO
-		indexOffset += unsigned(vertexBuffers[0]->getNumElements());
-		appendedIndexes += indexBuffer[0].getNumElements();
-	}
+void StaticMeshToShapeConverter::releaseReadback()
+{
+	//Don't need these requests anymore, unmap all tickets
+	releaseV2SubMeshes(mReadback);
+	mReadback.clear();
 }
 
 /*
@@ -579,9 +1449,7 @@ void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transf
 AnimatedMeshToShapeConverter::AnimatedMeshToShapeConverter(v1::Entity *entity, const Matrix4 &transform) :
 	VertexIndexToShape(transform),
 	mEntity(nullptr),
-	mNode(nullptr),
-	mTransformedVerticesTemp(nullptr),
-	mTransformedVerticesTempSize(0)
+	mNode(nullptr)
 {
 	addEntity(entity, transform);
 }
@@ -589,29 +1457,18 @@ AnimatedMeshToShapeConverter::AnimatedMeshToShapeConverter(v1::Entity *entity, c
 AnimatedMeshToShapeConverter::AnimatedMeshToShapeConverter() :
 	VertexIndexToShape(),
 	mEntity(nullptr),
-	mNode(nullptr),
-	mTransformedVerticesTemp(nullptr),
-	mTransformedVerticesTempSize(0)
-{
-}
-
-AnimatedMeshToShapeConverter::~AnimatedMeshToShapeConverter()
+	mNode(nullptr)
 {
-	delete[] mTransformedVerticesTemp;
 }
 
 void AnimatedMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &transform)
 {
-	// Each entity added need to reset size and radius
-	// next time getRadius and getSize are asked, they're computed.
-	mBounds = Vector3(-1, -1, -1);
-	mBoundRadius = -1;
-
 	mEntity = entity;
 	mNode = static_cast<SceneNode*>(mEntity->getParentNode());
 	mTransform = transform;
 
 	assert(entity->getMesh()->hasSkeleton());
+	mSkeleton = entity->getMesh()->getOldSkeleton();
 
 	mEntity->addSoftwareAnimationRequest(false);
 	mEntity->_updateAnimation();
@@ -641,18 +1498,19 @@ void AnimatedMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &
 		}
 	}
 
+	//The bones in the pose the vertices were skinned with
+	readBonePoses(mEntity);
+
 	mEntity->removeSoftwareAnimationRequest(false);
+	buildBoneLayout();
 }
 
 void AnimatedMeshToShapeConverter::addMesh(const v1::MeshPtr &mesh, const Matrix4 &transform)
 {
-	// Each entity added need to reset size and radius
-	// next time getRadius and getSize are asked, they're computed.
-	mBounds = Vector3(-1, -1, -1);
-	mBoundRadius = -1;
 	mTransform = transform;
 
 	assert(mesh->hasSkeleton());
+	mSkeleton = mesh->getOldSkeleton();
 
 	if (mesh->sharedVertexData[0])
 	{
@@ -678,70 +1536,143 @@ void AnimatedMeshToShapeConverter::addMesh(const v1::MeshPtr &mesh, const Matrix
 			appendV1IndexData(sub_mesh->indexData[0]);
 		}
 	}
+
+	readBonePoses(nullptr);
+	buildBoneLayout();
 }
 
-bool AnimatedMeshToShapeConverter::getBoneVertices(unsigned char bone,
-	unsigned int &vertex_count,
-	Vector3* &vertices,
-	const Vector3 &bonePosition)
+void AnimatedMeshToShapeConverter::readBonePoses(v1::Entity* entity)
 {
-	auto i = mBoneIndex->find(bone);
-
-	if (i == mBoneIndex->end())
-		return false;
+	mBonePoses.resize(mSkeleton->getNumBones());
+	for (unsigned short bone = 0; bone < mSkeleton->getNumBones(); ++bone)
+	{
+		if (entity)
+		{
+			//Derived transforms of the entity's skeleton instance, in the space of the mesh like the skinned vertices
+			const auto posed = entity->getSkeleton()->getBone(bone);
+			mBonePoses[bone] = { posed->_getDerivedPosition(), posed->_getDerivedOrientation() };
+		}
+		else
+		{
+			//Bones keep the inverse of their binding pose, in the space of the mesh
+			const auto oldBone = mSkeleton->getBone(bone);
+			mBonePoses[bone] = { -oldBone->_getBindingPoseInversePosition(), oldBone->_getBindingPoseInverseOrientation().Inverse() };
+		}
+	}
+}
 
-	if (i->second->empty())
-		return false;
+void AnimatedMeshToShapeConverter::getBonePose(unsigned short bone, Vector3& position, Quaternion& orientation) const
+{
+	position = mBonePoses[bone].first;
+	orientation = mBonePoses[bone].second;
+
+	//The vertices were transformed when they were added, the bones go with them
+	Vector3 translation, scale;
+	Quaternion rotation;
+	mTransform.decomposition(translation, scale, rotation);
+	position = mTransform * position;
+	orientation = rotation * orientation;
+}
 
-	vertex_count = static_cast<unsigned int>(i->second->size()) + 1;
-	if (vertex_count > mTransformedVerticesTempSize)
+std::vector<BoneShape> AnimatedMeshToShapeConverter::createBoneShapes(const SkeletonShapeSettings& settings) const
+{
+	std::vector<BoneShape> shapes;
+	if (mSkeleton.isNull())
+		return shapes;
+
+	//Bones weighting enough vertices, and the primitive they get
+	std::vector<std::pair<unsigned short, BonePrimitive>> bones;
+	const auto boneCount = std::min<size_t>(mBoneOffsets.size() - 1, mSkeleton->getNumBones());
+	for (auto bone = size_t{ 0 }; bone < boneCount; ++bone)
 	{
-		if (mTransformedVerticesTemp)
-			delete[] mTransformedVerticesTemp;
+		if (mBoneOffsets[bone + 1] - mBoneOffsets[bone] < std::max<size_t>(settings.minVertices, 1))
+			continue;
 
-		mTransformedVerticesTemp = new Vector3[vertex_count];
+		auto primitive = settings.primitive;
+		const auto found = settings.bonePrimitives.find(mSkeleton->getBone(static_cast<unsigned short>(bone))->getName());
+		if (found != settings.bonePrimitives.end())
+			primitive = found->second;
+
+		if (primitive != BonePrimitive::None)
+			bones.emplace_back(static_cast<unsigned short>(bone), primitive);
 	}
 
-	vertices = mTransformedVerticesTemp;
-	vertices[0] = bonePosition;
-	//mEntity->_getParentNodeFullTransform() *
-	//	mEntity->getSkeleton()->getBone(bone)->_getDerivedPosition();
+	//Each bone reads its own span of mBoneVertices, they're fitted independently
+	shapes.resize(bones.size());
+	const auto fitBone = [&](size_t i)
+	{
+		const auto bone = bones[i].first;
+		Vector3 position;
+		Quaternion orientation;
+		getBonePose(bone, position, orientation);
+
+		const Vector3* vertices;
+		size_t count;
+		getBoneVertices(bone, vertices, count);
+
+		//Bring the vertices in the frame of the bone
+		const auto toBone = orientation.Inverse();
+		VertexBuffer points;
+		points.reserve(count + 1);
+		for (auto v = size_t{ 0 }; v < count; ++v)
+			points.push_back(toBone * ((vertices[v] - position) * mScale));
+		if (settings.includeBoneOrigin)
+			points.push_back(Vector3::ZERO);
+
+		shapes[i].bone = bone;
+		shapes[i].shape = BoneShapeFitter::fit(bones[i].second, points.data(), points.size(), settings.hullVertexBudget, shapes[i].offset);
+	};
+
+	if (mThreadPool)
+		mThreadPool->parallelFor(bones.size(), fitBone);
+	else
+		for (auto i = size_t{ 0 }; i < bones.size(); ++i) fitBone(i);
+
+	//Bones whose vertices are all at the same place got no shape
+	shapes.erase(std::remove_if(shapes.begin(), shapes.end(), [](const BoneShape& shape) { return !shape.shape; }), shapes.end());
+	for (const auto& shape : shapes)
+		recordShape(shape.shape);
 
-	//mEntity->getSkeleton()->getBone(bone)->_getDerivedOrientation()
-	unsigned int currBoneVertex = 1;
-	auto j = i->second->begin();
-	while (j != i->second->end())
+	log("createBoneShapes : " + std::to_string(shapes.size()) + " shapes for " + std::to_string(mSkeleton->getNumBones()) + " bones");
+	return shapes;
+}
+
+btCompoundShape* AnimatedMeshToShapeConverter::createSkeletonShape(const SkeletonShapeSettings& settings) const
+{
+	const auto bones = createBoneShapes(settings);
+
+	auto compound = new btCompoundShape(true, static_cast<int>(bones.size()));
+	for (const auto& bone : bones)
 	{
-		vertices[currBoneVertex] = (*j);
-		++j;
-		++currBoneVertex;
+		Vector3 position;
+		Quaternion orientation;
+		getBonePose(bone.bone, position, orientation);
+
+		bone.shape->setUserIndex(bone.bone);
+		const btTransform boneTransform(Convert::toBullet(orientation), Convert::toBullet(position * mScale));
+		compound->addChildShape(boneTransform * bone.offset, bone.shape);
 	}
-	return true;
+
+	//The bone shapes were counted by createBoneShapes()
+	mMemory.addShape(MemoryStats::measureShape(compound, false));
+	return compound;
 }
 
-btBoxShape* AnimatedMeshToShapeConverter::createAlignedBox(unsigned char bone,
+btBoxShape* AnimatedMeshToShapeConverter::createAlignedBox(unsigned short bone,
 	const Vector3 &bonePosition,
 	const Quaternion &boneOrientation)
 {
-	unsigned int vertex_count;
-	Vector3* vertices;
-
-	if (!getBoneVertices(bone, vertex_count, vertices, bonePosition))
+	//Bone bounds were gathered during extraction, only the bone itself has to be added
+	const Vector3* vertices;
+	size_t vertexCount;
+	if (!getBoneVertices(bone, vertices, vertexCount))
 		return nullptr;
 
-	auto min_vec(vertices[0]);
-	auto max_vec(vertices[0]);
-
-	for (unsigned int j = 1; j < vertex_count; j++)
-	{
-		min_vec.x = std::min(min_vec.x, vertices[j].x);
-		min_vec.y = std::min(min_vec.y, vertices[j].y);
-		min_vec.z = std::min(min_vec.z, vertices[j].z);
+	auto min_vec(mBoneBounds[bone].first);
+	auto max_vec(mBoneBounds[bone].second);
+	min_vec.makeFloor(bonePosition);
+	max_vec.makeCeil(bonePosition);
 
-		max_vec.x = std::max(max_vec.x, vertices[j].x);
-		max_vec.y = std::max(max_vec.y, vertices[j].y);
-		max_vec.z = std::max(max_vec.z, vertices[j].z);
-	}
 	const auto maxMinusMin(max_vec - min_vec);
 	auto box = new btBoxShape(Convert::toBullet(maxMinusMin));
 
@@ -752,30 +1683,31 @@ btBoxShape* AnimatedMeshToShapeConverter::createAlignedBox(unsigned char bone,
 
 		//box->setPosition(pos);
 
-	return box;
+	return recordShape(box);
 }
 
-bool AnimatedMeshToShapeConverter::getOrientedBox(unsigned char bone,
+bool AnimatedMeshToShapeConverter::getOrientedBox(unsigned short bone,
 	const Vector3 &bonePosition,
 	const Quaternion &boneOrientation,
 	Vector3 &box_afExtent,
 	Vector3 *box_akAxis,
 	Vector3 &box_kCenter)
 {
-	unsigned int vertex_count;
-	Vector3* vertices;
+	size_t vertex_count;
+	const Vector3* vertices;
 
-	if (!getBoneVertices(bone, vertex_count, vertices, bonePosition))
+	if (!getBoneVertices(bone, vertices, vertex_count))
 		return false;
 
-	box_kCenter = Vector3::ZERO;
+	//The bone position counts in the center, the extents only come from the bone's vertices
+	box_kCenter = bonePosition;
 
 	{
-		for (unsigned int c = 0; c < vertex_count; c++)
+		for (size_t c = 0; c < vertex_count; c++)
 		{
 			box_kCenter += vertices[c];
 		}
-		const auto invVertexCount = 1.0f / vertex_count;
+		const auto invVertexCount = 1.0f / (vertex_count + 1);
 		box_kCenter *= invVertexCount;
 	}
 	auto orient = boneOrientation;
@@ -788,12 +1720,12 @@ bool AnimatedMeshToShapeConverter::getOrientedBox(unsigned char bone,
 	// C' = C + 0.5*(min(y0)+max(y0))*U0 + 0.5*(min(y1)+max(y1))*U1 +
 	//      0.5*(min(y2)+max(y2))*U2
 
-	auto kDiff(vertices[1] - box_kCenter);
+	auto kDiff(vertices[0] - box_kCenter);
 	auto fY0Min = kDiff.dotProduct(box_akAxis[0]), fY0Max = fY0Min;
 	auto fY1Min = kDiff.dotProduct(box_akAxis[1]), fY1Max = fY1Min;
 	auto fY2Min = kDiff.dotProduct(box_akAxis[2]), fY2Max = fY2Min;
 
-	for (unsigned int i = 2; i < vertex_count; i++)
+	for (size_t i = 1; i < vertex_count; i++)
 	{
 		kDiff = vertices[i] - box_kCenter;
 
@@ -829,10 +1761,24 @@ bool AnimatedMeshToShapeConverter::getOrientedBox(unsigned char bone,
 	return true;
 }
 
-btBoxShape *AnimatedMeshToShapeConverter::createOrientedBox(unsigned char bone,
+btBoxShape *AnimatedMeshToShapeConverter::createOrientedBox(unsigned short bone,
 	const Vector3 &bonePosition,
-	const Quaternion &boneOrientation)
+	const Quaternion &boneOrientation,
+	btTransform* transform)
 {
+	if (transform)
+	{
+		//Placed with its transform, the box gets its real half extents: tight around the bone's vertices
+		const Vector3* vertices;
+		size_t count;
+		if (!getBoneVertices(bone, vertices, count))
+			return nullptr;
+
+		const auto box = OrientedBoxFitter::fitAxes(vertices, count, boneOrientation);
+		*transform = box.getTransform();
+		return recordShape(box.createShape());
+	}
+
 	Vector3 box_akAxis[3];
 	Vector3 box_afExtent;
 	Vector3 box_afCenter;
@@ -843,8 +1789,21 @@ btBoxShape *AnimatedMeshToShapeConverter::createOrientedBox(unsigned char bone,
 		box_afCenter))
 		return nullptr;
 
-	auto geom = new btBoxShape(Convert::toBullet(box_afExtent));
-	//geom->setOrientation(Quaternion(box_akAxis[0],box_akAxis[1],box_akAxis[2]));
-	//geom->setPosition(box_afCenter);
-	return geom;
+	return recordShape(new btBoxShape(Convert::toBullet(box_afExtent)));
+}
+
+btBoxShape* AnimatedMeshToShapeConverter::createFittedBox(unsigned short bone, btTransform& transform) const
+{
+	const Vector3* vertices;
+	size_t count;
+	if (!getBoneVertices(bone, vertices, count))
+		return nullptr;
+
+	auto points = VertexBuffer(vertices, vertices + count);
+	for (auto& point : points)
+		point *= mScale;
+
+	const auto box = OrientedBoxFitter::fit(points.data(), points.size());
+	transform = box.getTransform();
+	return recordShape(box.createShape());
 }
@@ -0,0 +1,206 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreHeightfield.cpp
+ *
+ *    Description:  BtOgre heightfield shapes implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreHeightfield.h"
+#include "BtOgreExtras.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Lowest and highest of the samples
+	void getHeightRange(const float* heights, size_t count, float& minHeight, float& maxHeight)
+	{
+		minHeight = std::numeric_limits<float>::max();
+		maxHeight = -std::numeric_limits<float>::max();
+		for (auto i = size_t{ 0 }; i < count; ++i)
+		{
+			minHeight = std::min(minHeight, heights[i]);
+			maxHeight = std::max(maxHeight, heights[i]);
+		}
+	}
+
+	///Check that the coordinates are evenly spaced, and get their start, count and spacing
+	bool getAxis(std::vector<Real>& coordinates, Real epsilon, Real& start, int& count, Real& spacing)
+	{
+		std::sort(coordinates.begin(), coordinates.end());
+
+		//Merge the values closer than epsilon
+		std::vector<Real> distinct{ coordinates.front() };
+		for (const auto value : coordinates)
+			if (value - distinct.back() > epsilon)
+				distinct.push_back(value);
+
+		if (distinct.size() < 2 || distinct.size() > size_t(std::numeric_limits<int>::max()))
+			return false;
+
+		start = distinct.front();
+		count = int(distinct.size());
+		spacing = (distinct.back() - start) / (count - 1);
+
+		for (auto i = 0; i < count; ++i)
+			if (std::abs(distinct[i] - (start + i * spacing)) > epsilon)
+				return false;
+
+		return true;
+	}
+}
+
+detail::HeightStorage::HeightStorage(std::vector<float>&& heights) :
+	mHeights(std::move(heights))
+{
+}
+
+OwningHeightfieldTerrainShape::OwningHeightfieldTerrainShape(std::vector<float>&& heights, int width, int length,
+	float minHeight, float maxHeight, bool flipQuadEdges) :
+	HeightStorage(std::move(heights)),
+	btHeightfieldTerrainShape(width, length, mHeights.data(), 1, minHeight, maxHeight, 1, PHY_FLOAT, flipQuadEdges)
+{
+}
+
+Vector3 Heightfield::getOriginOffset(int width, int length, float minHeight, float maxHeight,
+	const Vector3& spacing, const Vector3& corner)
+{
+	//Bullet puts the middle of the samples' bounding box at the shape origin
+	return corner + Vector3((width - 1) * spacing.x, (minHeight + maxHeight) * spacing.y, (length - 1) * spacing.z) * 0.5f;
+}
+
+btHeightfieldTerrainShape* Heightfield::create(const float* heights, int width, int length,
+	const Vector3& spacing, const Vector3& corner, Vector3& originOffset, bool flipQuadEdges)
+{
+	float minHeight, maxHeight;
+	getHeightRange(heights, size_t(width) * size_t(length), minHeight, maxHeight);
+
+	auto shape = new btHeightfieldTerrainShape(width, length, heights, 1, minHeight, maxHeight, 1, PHY_FLOAT, flipQuadEdges);
+	shape->setLocalScaling(Convert::toBullet(spacing));
+
+	originOffset = getOriginOffset(width, length, minHeight, maxHeight, spacing, corner);
+	return shape;
+}
+
+OwningHeightfieldTerrainShape* Heightfield::create(HeightfieldGrid&& grid, Vector3& originOffset)
+{
+	float minHeight, maxHeight;
+	getHeightRange(grid.heights.data(), grid.heights.size(), minHeight, maxHeight);
+
+	auto shape = new OwningHeightfieldTerrainShape(std::move(grid.heights), grid.width, grid.length, minHeight, maxHeight, grid.flipQuadEdges);
+	shape->setLocalScaling(Convert::toBullet(grid.spacing));
+
+	originOffset = getOriginOffset(grid.width, grid.length, minHeight, maxHeight, grid.spacing, grid.corner);
+	return shape;
+}
+
+bool Heightfield::detectGrid(const Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+	HeightfieldGrid& grid, Real tolerance)
+{
+	if (vertexCount < 4 || indexCount < 6) return false;
+
+	std::vector<Real> xs(vertexCount), zs(vertexCount);
+	for (auto i = size_t{ 0 }; i < vertexCount; ++i)
+	{
+		xs[i] = vertices[i].x;
+		zs[i] = vertices[i].z;
+	}
+
+	const auto extentX = *std::max_element(xs.begin(), xs.end()) - *std::min_element(xs.begin(), xs.end());
+	const auto extentZ = *std::max_element(zs.begin(), zs.end()) - *std::min_element(zs.begin(), zs.end());
+	const auto epsilon = tolerance * std::max(extentX, extentZ);
+
+	Real startX, startZ, spacingX, spacingZ;
+	int width, length;
+	if (!getAxis(xs, epsilon, startX, width, spacingX) || !getAxis(zs, epsilon, startZ, length, spacingZ))
+		return false;
+
+	//Less vertices than samples means there are holes
+	if (size_t(width) * size_t(length) > vertexCount)
+		return false;
+
+	//Sample of each vertex. Duplicates must have the same height
+	std::vector<unsigned> cells(vertexCount);
+	std::vector<float> heights(size_t(width) * size_t(length), std::numeric_limits<float>::quiet_NaN());
+	for (auto i = size_t{ 0 }; i < vertexCount; ++i)
+	{
+		const auto x = int(std::lround((vertices[i].x - startX) / spacingX));
+		const auto z = int(std::lround((vertices[i].z - startZ) / spacingZ));
+		if (x < 0 || x >= width || z < 0 || z >= length
+			|| std::abs(vertices[i].x - (startX + x * spacingX)) > epsilon
+			|| std::abs(vertices[i].z - (startZ + z * spacingZ)) > epsilon)
+			return false;
+
+		cells[i] = unsigned(z * width + x);
+
+		auto& height = heights[cells[i]];
+		if (std::isnan(height))
+			height = float(vertices[i].y);
+		else if (std::abs(height - vertices[i].y) > epsilon)
+			return false;
+	}
+
+	if (std::any_of(heights.begin(), heights.end(), [](float height) { return std::isnan(height); }))
+		return false;
+
+	//Every cell must be split in its two halves along one diagonal, the same for the whole grid. Each half misses one corner of
+	//the cell, numbered x + 2 * z: the halves of the (x+1, z)-(x, z+1) diagonal miss corners 0 and 3, the flipped ones 1 and 2
+	constexpr auto regularHalves = uint8_t{ 0x9 };
+	constexpr auto flippedHalves = uint8_t{ 0x6 };
+	std::vector<uint8_t> missingCorners(size_t(width - 1) * size_t(length - 1), 0);
+	for (auto t = size_t{ 0 }; t + 2 < indexCount; t += 3)
+	{
+		int x[3], z[3];
+		for (auto i = 0; i < 3; ++i)
+		{
+			x[i] = int(cells[indices[t + i]] % unsigned(width));
+			z[i] = int(cells[indices[t + i]] / unsigned(width));
+		}
+
+		const auto minX = std::min({ x[0], x[1], x[2] });
+		const auto minZ = std::min({ z[0], z[1], z[2] });
+		if (std::max({ x[0], x[1], x[2] }) != minX + 1 || std::max({ z[0], z[1], z[2] }) != minZ + 1)
+			return false;
+
+		//Three different corners of the cell, not a degenerate triangle
+		auto corners = 0;
+		for (auto i = 0; i < 3; ++i)
+			corners |= 1 << ((x[i] - minX) + 2 * (z[i] - minZ));
+		if (corners != 0x7 && corners != 0xb && corners != 0xd && corners != 0xe)
+			return false;
+
+		//A second triangle on the same half overlaps the first one
+		auto& missing = missingCorners[size_t(minZ) * size_t(width - 1) + size_t(minX)];
+		const auto half = uint8_t(~corners & 0xf);
+		if (missing & half)
+			return false;
+		missing |= half;
+	}
+
+	//Holes, or cells split along the other diagonal, would collide differently as a heightfield
+	const auto split = missingCorners.front();
+	if ((split != regularHalves && split != flippedHalves)
+		|| std::any_of(missingCorners.begin(), missingCorners.end(), [split](uint8_t missing) { return missing != split; }))
+		return false;
+
+	grid.heights = std::move(heights);
+	grid.width = width;
+	grid.length = length;
+	grid.spacing = Vector3(spacingX, 1, spacingZ);
+	grid.corner = Vector3(startX, 0, startZ);
+	grid.flipQuadEdges = split == flippedHalves;
+	return true;
+}
@@ -0,0 +1,50 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreInternal.h
+ *
+ *    Description:  Helpers shared by the BtOgre sources. Not installed, not part of
+ *                  the API.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <string>
+
+#include <OgreLogManager.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	namespace detail
+	{
+		using Clock = std::chrono::steady_clock;
+
+		///Milliseconds elapsed since start
+		inline double millisecondsSince(Clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		///Minimum and maximum of an empty box, any point grows them to itself
+		inline void makeEmptyBounds(Ogre::Vector3& minimum, Ogre::Vector3& maximum)
+		{
+			minimum = Ogre::Vector3(std::numeric_limits<Ogre::Real>::infinity());
+			maximum = Ogre::Vector3(-std::numeric_limits<Ogre::Real>::infinity());
+		}
+
+		///Write to Ogre's log. Messages start with the part of BtOgre writing them, like "ShapeCache : "
+		inline void log(const std::string& message)
+		{
+			Ogre::LogManager::getSingleton().logMessage("BtOgreLog : " + message);
+		}
+	}
+}
@@ -0,0 +1,303 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreMemoryStats.cpp
+ *
+ *    Description:  BtOgre memory accounting implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreMemoryStats.h"
+#include "BtOgreGP.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <BulletCollision/BroadphaseCollision/btDbvt.h>
+#include <BulletCollision/CollisionShapes/btConvexPolyhedron.h>
+#include <BulletCollision/CollisionShapes/btTriangleInfoMap.h>
+#include <BulletCollision/CollisionShapes/btConvexPointCloudShape.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btUniformScalingShape.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	std::atomic<size_t> converterMemory{ 0 };
+	std::atomic<size_t> converterPeak{ 0 };
+	std::atomic<size_t> createdShapeCount{ 0 };
+	std::atomic<size_t> createdShapeMemory{ 0 };
+
+	///Add to the memory of the converters, and raise the peak if needed
+	void growConverterMemory(size_t bytes)
+	{
+		const auto now = converterMemory += bytes;
+		auto peak = converterPeak.load();
+		while (now > peak && !converterPeak.compare_exchange_weak(peak, now));
+	}
+
+	void shrinkConverterMemory(size_t bytes)
+	{
+		converterMemory -= bytes;
+	}
+
+	///Measure the polyhedral features of a convex shape, 0 if it has none
+	size_t measurePolyhedron(const btCollisionShape* shape)
+	{
+		if (!shape->isPolyhedral()) return 0;
+
+		//Custom polyhedral shapes don't have to derive from btPolyhedralConvexShape
+		const auto polyhedral = dynamic_cast<const btPolyhedralConvexShape*>(shape);
+		const auto polyhedron = polyhedral ? polyhedral->getConvexPolyhedron() : nullptr;
+		if (!polyhedron) return 0;
+
+		auto size = sizeof(btConvexPolyhedron) + size_t(polyhedron->m_vertices.capacity() + polyhedron->m_uniqueEdges.capacity()) * sizeof(btVector3)
+			+ size_t(polyhedron->m_faces.capacity()) * sizeof(btFace);
+		for (auto i = 0; i < polyhedron->m_faces.size(); ++i)
+			size += size_t(polyhedron->m_faces[i].m_indices.capacity()) * sizeof(int);
+		return size;
+	}
+
+	///Estimate the memory of a triangle info map: its hash table holds a key, a value, a bucket and a link per entry
+	size_t measureTriangleInfoMap(const btTriangleInfoMap* triangleInfoMap)
+	{
+		if (!triangleInfoMap) return 0;
+		return sizeof(btTriangleInfoMap) + size_t(triangleInfoMap->size()) * (sizeof(btHashInt) + sizeof(btTriangleInfo) + 2 * sizeof(int));
+	}
+}
+
+size_t MemoryStats::measureBvh(const btOptimizedBvh* optimizedBvh, size_t triangles)
+{
+	if (!optimizedBvh) return 0;
+
+	//Bullet's accessors to the BVH aren't const
+	const auto bvh = const_cast<btOptimizedBvh*>(optimizedBvh);
+	auto size = sizeof(btOptimizedBvh);
+	if (bvh->isQuantized())
+		size += size_t(bvh->getQuantizedNodeArray().size()) * sizeof(btQuantizedBvhNode);
+	else //The non quantized nodes aren't accessible, a full tree has two nodes per triangle
+		size += 2 * triangles * sizeof(btOptimizedBvhNode);
+	size += size_t(bvh->getSubtreeInfoArray().size()) * sizeof(btBvhSubtreeInfo);
+	return size;
+}
+
+ShapeMemory MemoryStats::measureShape(const btCollisionShape* shape, bool includeChildren)
+{
+	ShapeMemory memory{ 0, 0, 0 };
+	if (!shape) return memory;
+
+	switch (shape->getShapeType())
+	{
+	case TRIANGLE_MESH_SHAPE_PROXYTYPE:
+	{
+		const auto trimesh = const_cast<btBvhTriangleMeshShape*>(static_cast<const btBvhTriangleMeshShape*>(shape));
+		memory.shape = sizeof(btBvhTriangleMeshShape);
+		auto triangles = size_t{ 0 };
+
+		if (const auto array = dynamic_cast<const btTriangleIndexVertexArray*>(trimesh->getMeshInterface()))
+		{
+			const auto& parts = array->getIndexedMeshArray();
+			for (auto i = 0; i < parts.size(); ++i)
+			{
+				//Parts sharing a vertex base share its vertices
+				auto sharedVertices = false;
+				for (auto j = 0; j < i && !sharedVertices; ++j)
+					sharedVertices = parts[j].m_vertexBase == parts[i].m_vertexBase;
+				if (!sharedVertices)
+					memory.meshData += size_t(parts[i].m_numVertices) * parts[i].m_vertexStride;
+
+				memory.meshData += size_t(parts[i].m_numTriangles) * parts[i].m_triangleIndexStride;
+				triangles += size_t(parts[i].m_numTriangles);
+			}
+		}
+
+		//The PHY_SHORT parts of an owning trimesh are overlapping windows on one vertex buffer: count the buffers it owns instead
+		if (const auto owning = dynamic_cast<const OwningBvhTriangleMeshShape*>(shape))
+		{
+			memory.shape = sizeof(OwningBvhTriangleMeshShape);
+			memory.meshData = owning->getVertexBuffer().capacity() * sizeof(Vector3)
+				+ owning->getIndexBuffer().capacity() * sizeof(unsigned int)
+				+ owning->getShortIndexBuffer().capacity() * sizeof(uint16_t);
+		}
+
+		memory.meshData += measureTriangleInfoMap(trimesh->getTriangleInfoMap());
+		memory.bvh = measureBvh(trimesh->getOptimizedBvh(), triangles);
+		break;
+	}
+
+	case CUSTOM_CONCAVE_SHAPE_TYPE:
+		if (const auto quantized = dynamic_cast<const QuantizedBvhTriangleMeshShape*>(shape))
+		{
+			memory.shape = sizeof(QuantizedBvhTriangleMeshShape);
+			memory.meshData = quantized->getQuantizedMesh().getMemoryUsage();
+			memory.bvh = measureBvh(quantized->getOptimizedBvh(), quantized->getQuantizedMesh().getTriangleCount());
+		}
+		else
+		{
+			memory.shape = sizeof(btConcaveShape);
+		}
+		break;
+
+	case TERRAIN_SHAPE_PROXYTYPE:
+		memory.shape = sizeof(btHeightfieldTerrainShape);
+		if (const auto heightfield = dynamic_cast<const OwningHeightfieldTerrainShape*>(shape))
+			memory.meshData = heightfield->getHeights().capacity() * sizeof(float);
+		break;
+
+	case CONVEX_HULL_SHAPE_PROXYTYPE:
+		memory.shape = sizeof(btConvexHullShape);
+		memory.meshData = size_t(static_cast<const btConvexHullShape*>(shape)->getNumPoints()) * sizeof(btVector3);
+		break;
+
+	case COMPOUND_SHAPE_PROXYTYPE:
+	{
+		const auto compound = static_cast<const btCompoundShape*>(shape);
+		const auto children = size_t(compound->getNumChildShapes());
+		memory.shape = sizeof(btCompoundShape) + children * sizeof(btCompoundShapeChild);
+		memory.bvh = 2 * children * sizeof(btDbvtNode);
+
+		if (includeChildren)
+		{
+			for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+			{
+				const auto child = measureShape(compound->getChildShape(i));
+				memory.shape += child.shape;
+				memory.meshData += child.meshData;
+				memory.bvh += child.bvh;
+			}
+		}
+		break;
+	}
+
+	//Wrappers only point to the data of the shape they wrap
+	case SCALED_TRIANGLE_MESH_SHAPE_PROXYTYPE: memory.shape = sizeof(btScaledBvhTriangleMeshShape); break;
+	case UNIFORM_SCALING_SHAPE_PROXYTYPE: memory.shape = sizeof(btUniformScalingShape); break;
+	case CONVEX_POINT_CLOUD_SHAPE_PROXYTYPE: memory.shape = sizeof(btConvexPointCloudShape); break;
+
+	case BOX_SHAPE_PROXYTYPE: memory.shape = sizeof(btBoxShape); break;
+	case SPHERE_SHAPE_PROXYTYPE: memory.shape = sizeof(btSphereShape); break;
+	case CAPSULE_SHAPE_PROXYTYPE: memory.shape = sizeof(btCapsuleShape); break;
+	case CYLINDER_SHAPE_PROXYTYPE: memory.shape = sizeof(btCylinderShape); break;
+	default: memory.shape = sizeof(btCollisionShape); break;
+	}
+
+	//Boxes, hulls and their instances get them from initializePolyhedralFeatures(), for SAT contact clipping
+	memory.meshData += measurePolyhedron(shape);
+
+	return memory;
+}
+
+size_t MemoryStats::getConverterMemory()
+{
+	return converterMemory.load();
+}
+
+size_t MemoryStats::getConverterPeak()
+{
+	return converterPeak.load();
+}
+
+void MemoryStats::resetConverterPeak()
+{
+	converterPeak = converterMemory.load();
+}
+
+size_t MemoryStats::getCreatedShapeCount()
+{
+	return createdShapeCount.load();
+}
+
+size_t MemoryStats::getCreatedShapeMemory()
+{
+	return createdShapeMemory.load();
+}
+
+void MemoryStats::resetCreatedShapes()
+{
+	createdShapeCount = 0;
+	createdShapeMemory = 0;
+}
+
+detail::ConverterMemory::ConverterMemory() :
+	mBufferMemory(0),
+	mPeak(0),
+	mShapeCount(0),
+	mShapeMemory(0)
+{
+}
+
+detail::ConverterMemory::ConverterMemory(const ConverterMemory& other) :
+	mBufferMemory(other.mBufferMemory),
+	mPeak(other.mBufferMemory),
+	mShapeCount(0),
+	mShapeMemory(0)
+{
+	growConverterMemory(mBufferMemory);
+}
+
+detail::ConverterMemory& detail::ConverterMemory::operator=(const ConverterMemory& other)
+{
+	setBufferMemory(other.mBufferMemory);
+	return *this;
+}
+
+detail::ConverterMemory::ConverterMemory(ConverterMemory&& other) :
+	mBufferMemory(other.mBufferMemory),
+	mPeak(other.mPeak),
+	mShapeCount(other.mShapeCount),
+	mShapeMemory(other.mShapeMemory)
+{
+	//Already counted in the totals, only the owner changes
+	other.mBufferMemory = 0;
+	other.mPeak = 0;
+	other.mShapeCount = 0;
+	other.mShapeMemory = 0;
+}
+
+detail::ConverterMemory& detail::ConverterMemory::operator=(ConverterMemory&& other)
+{
+	if (this == &other) return *this;
+
+	//This converter's buffers were freed by the move, the other's are counted here now
+	shrinkConverterMemory(mBufferMemory);
+	mBufferMemory = other.mBufferMemory;
+	mPeak = std::max(mPeak, mBufferMemory);
+	other.mBufferMemory = 0;
+	return *this;
+}
+
+detail::ConverterMemory::~ConverterMemory()
+{
+	shrinkConverterMemory(mBufferMemory);
+}
+
+void detail::ConverterMemory::setBufferMemory(size_t bytes)
+{
+	if (bytes > mBufferMemory)
+		growConverterMemory(bytes - mBufferMemory);
+	else
+		shrinkConverterMemory(mBufferMemory - bytes);
+
+	mBufferMemory = bytes;
+	mPeak = std::max(mPeak, bytes);
+}
+
+void detail::ConverterMemory::addShape(const ShapeMemory& memory)
+{
+	++mShapeCount;
+	mShapeMemory += memory.getTotal();
+	++createdShapeCount;
+	createdShapeMemory += memory.getTotal();
+}
+
+void detail::ConverterMemory::resetPeak()
+{
+	mPeak = mBufferMemory;
+}
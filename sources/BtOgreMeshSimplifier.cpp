@@ -0,0 +1,422 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreMeshSimplifier.cpp
+ *
+ *    Description:  BtOgre quadric error mesh simplification implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreMeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Weight of the planes that hold border edges in place, relative to the squared edge length
+	constexpr double borderWeight{ 1000 };
+
+	///Smallest cosine between a triangle normal before and after a collapse. Lower than that, the collapse folds the surface
+	constexpr double minNormalCosine{ 0.2 };
+
+	///Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+	struct Quadric
+	{
+		//xx xy xz xw yy yz yw zz zw ww
+		double m[10];
+
+		///Area of the triangles summed in, to turn the error into a mean squared distance
+		double area;
+
+		Quadric() :
+			area(0)
+		{
+			std::fill(m, m + 10, 0.0);
+		}
+
+		///Squared distance to the plane ax + by + cz + d = 0 (with a unit normal), times weight
+		static Quadric plane(double a, double b, double c, double d, double weight)
+		{
+			Quadric q;
+			q.m[0] = weight * a * a; q.m[1] = weight * a * b; q.m[2] = weight * a * c; q.m[3] = weight * a * d;
+			q.m[4] = weight * b * b; q.m[5] = weight * b * c; q.m[6] = weight * b * d;
+			q.m[7] = weight * c * c; q.m[8] = weight * c * d;
+			q.m[9] = weight * d * d;
+			return q;
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			for (auto i = 0; i < 10; ++i) m[i] += other.m[i];
+			area += other.area;
+			return *this;
+		}
+
+		double evaluate(double x, double y, double z) const
+		{
+			return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+				+ m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+				+ m[7] * z * z + 2 * m[8] * z
+				+ m[9];
+		}
+
+		///Area weighted mean of the squared distances to the triangle planes (border planes add to it)
+		double evaluate(const Vector3& p) const
+		{
+			return std::max(0.0, evaluate(p.x, p.y, p.z)) / std::max(area, 1e-30);
+		}
+
+		///Point where the error is the lowest. False if the planes don't define a single point
+		bool optimum(Vector3& p) const
+		{
+			const auto a = m[0], b = m[1], c = m[2], e = m[4], f = m[5], h = m[7];
+			const auto determinant = a * (e * h - f * f) - b * (b * h - f * c) + c * (b * f - e * c);
+			if (std::abs(determinant) < 1e-12) return false;
+
+			//Cramer on the 3x3 system, right hand side is -(xw, yw, zw)
+			const auto u = -m[3], v = -m[6], w = -m[8];
+			p.x = Real((u * (e * h - f * f) - b * (v * h - f * w) + c * (v * f - e * w)) / determinant);
+			p.y = Real((a * (v * h - w * f) - u * (b * h - f * c) + c * (b * w - v * c)) / determinant);
+			p.z = Real((a * (e * w - f * v) - b * (b * w - v * c) + u * (b * f - e * c)) / determinant);
+			return true;
+		}
+	};
+
+	///Candidate collapse of v1 into v0, valid while neither vertex changed
+	struct Collapse
+	{
+		double cost;
+		double squaredLength;
+		unsigned v0, v1;
+		unsigned version0, version1;
+		Vector3 target;
+
+		///Order of the priority queue: cheapest first, then shortest, then by vertex so the result doesn't depend on the heap.
+		///Flat areas cost nothing to collapse, taking short edges first there avoids growing huge triangle fans
+		bool operator<(const Collapse& other) const
+		{
+			if (cost != other.cost) return cost > other.cost;
+			if (squaredLength != other.squaredLength) return squaredLength > other.squaredLength;
+			if (v0 != other.v0) return v0 > other.v0;
+			return v1 > other.v1;
+		}
+	};
+
+	uint64_t edgeKey(unsigned a, unsigned b)
+	{
+		return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+	}
+
+	///State of the simplification
+	class Simplification
+	{
+	public:
+		Simplification(const std::vector<Vector3>& vertices, const std::vector<unsigned>& indices, bool preserveBorders) :
+			mPositions(vertices),
+			mQuadrics(vertices.size()),
+			mVersions(vertices.size(), 0),
+			mTriangles(indices.begin(), indices.begin() + 3 * (indices.size() / 3)),
+			mAlive(indices.size() / 3, true),
+			mVertexTriangles(vertices.size()),
+			mLiveTriangles(indices.size() / 3)
+		{
+			std::unordered_map<uint64_t, std::pair<unsigned, unsigned>> edgeUses;
+			edgeUses.reserve(mTriangles.size());
+
+			for (auto t = 0u; t < mAlive.size(); ++t)
+			{
+				const auto& a = mPositions[mTriangles[3 * t]];
+				auto normal = (mPositions[mTriangles[3 * t + 1]] - a).crossProduct(mPositions[mTriangles[3 * t + 2]] - a);
+				const auto doubleArea = normal.normalise();
+
+				//Area weighted, so a few slivers don't outweigh the big faces
+				auto quadric = Quadric::plane(normal.x, normal.y, normal.z, -normal.dotProduct(a), doubleArea / 2);
+				quadric.area = doubleArea / 2;
+				for (auto i = 0u; i < 3; ++i)
+				{
+					const auto vertex = mTriangles[3 * t + i];
+					mQuadrics[vertex] += quadric;
+					mVertexTriangles[vertex].push_back(t);
+
+					auto& uses = edgeUses[edgeKey(vertex, mTriangles[3 * t + (i + 1) % 3])];
+					++uses.first;
+					uses.second = t;
+				}
+			}
+
+			if (preserveBorders)
+				for (const auto& edge : edgeUses)
+				{
+					if (edge.second.first != 1) continue;
+
+					//Plane through the border edge, perpendicular to its triangle
+					const auto t = edge.second.second;
+					const auto& a = mPositions[unsigned(edge.first >> 32)];
+					const auto& b = mPositions[unsigned(edge.first & 0xffffffff)];
+					const auto& c = mPositions[mTriangles[3 * t]];
+					auto faceNormal = (mPositions[mTriangles[3 * t + 1]] - c).crossProduct(mPositions[mTriangles[3 * t + 2]] - c);
+					faceNormal.normalise();
+
+					auto normal = (b - a).crossProduct(faceNormal);
+					if (normal.normalise() == 0) continue;
+
+					const auto quadric = Quadric::plane(normal.x, normal.y, normal.z, -normal.dotProduct(a), borderWeight * a.squaredDistance(b));
+					mQuadrics[unsigned(edge.first >> 32)] += quadric;
+					mQuadrics[unsigned(edge.first & 0xffffffff)] += quadric;
+				}
+
+			//Queue each edge once
+			for (const auto& edge : edgeUses)
+				push(unsigned(edge.first >> 32), unsigned(edge.first & 0xffffffff));
+		}
+
+		///Collapse edges until one of the limits is reached. Return the error of the last collapse
+		double run(size_t targetTriangles, double maxCost)
+		{
+			auto error = 0.0;
+			while (mLiveTriangles > targetTriangles && !mQueue.empty())
+			{
+				const auto collapse = mQueue.top();
+				if (collapse.cost > maxCost) break;
+				mQueue.pop();
+
+				//One of the vertices changed since this was queued, a fresh entry was queued then
+				if (collapse.version0 != mVersions[collapse.v0] || collapse.version1 != mVersions[collapse.v1])
+					continue;
+
+				if (!canCollapse(collapse.v0, collapse.v1, collapse.target))
+					continue;
+
+				apply(collapse.v0, collapse.v1, collapse.target);
+				error = std::max(error, collapse.cost);
+			}
+			return error;
+		}
+
+		///Write the remaining triangles and the vertices they use
+		void write(std::vector<Vector3>& vertices, std::vector<unsigned>& indices) const
+		{
+			std::vector<unsigned> remap(mPositions.size(), ~0u);
+			for (auto t = size_t{ 0 }; t < mAlive.size(); ++t)
+				if (mAlive[t])
+					for (auto i = 0u; i < 3; ++i)
+						remap[mTriangles[3 * t + i]] = 0;
+
+			vertices.clear();
+			for (auto v = size_t{ 0 }; v < mPositions.size(); ++v)
+				if (remap[v] != ~0u)
+				{
+					remap[v] = unsigned(vertices.size());
+					vertices.push_back(mPositions[v]);
+				}
+
+			indices.clear();
+			indices.reserve(3 * mLiveTriangles);
+			for (auto t = size_t{ 0 }; t < mAlive.size(); ++t)
+				if (mAlive[t])
+					for (auto i = 0u; i < 3; ++i)
+						indices.push_back(remap[mTriangles[3 * t + i]]);
+		}
+
+		size_t getLiveTriangles() const { return mLiveTriangles; }
+
+	private:
+		///Queue the collapse of this edge, to the best point for the two vertex quadrics
+		void push(unsigned v0, unsigned v1)
+		{
+			auto quadric = mQuadrics[v0];
+			quadric += mQuadrics[v1];
+
+			Collapse collapse;
+			collapse.v0 = v0;
+			collapse.v1 = v1;
+			collapse.version0 = mVersions[v0];
+			collapse.version1 = mVersions[v1];
+
+			//The optimum can be far away when the planes are nearly parallel, only trust it near the edge
+			const auto& p0 = mPositions[v0];
+			const auto& p1 = mPositions[v1];
+			collapse.squaredLength = p0.squaredDistance(p1);
+			Vector3 optimum;
+			if (quadric.optimum(optimum) && optimum.squaredDistance(p0.midPoint(p1)) <= p0.squaredDistance(p1))
+			{
+				collapse.target = optimum;
+				collapse.cost = quadric.evaluate(optimum);
+			}
+			else
+			{
+				collapse.cost = std::numeric_limits<double>::max();
+				for (const auto& candidate : { p0, p1, p0.midPoint(p1) })
+				{
+					const auto cost = quadric.evaluate(candidate);
+					if (cost < collapse.cost)
+					{
+						collapse.cost = cost;
+						collapse.target = candidate;
+					}
+				}
+			}
+
+			collapse.cost = std::max(0.0, collapse.cost);
+			mQueue.push(collapse);
+		}
+
+		///Vertices sharing a live triangle with this one
+		void getNeighbors(unsigned vertex, std::vector<unsigned>& neighbors) const
+		{
+			neighbors.clear();
+			for (const auto t : mVertexTriangles[vertex])
+				if (mAlive[t])
+					for (auto i = 0u; i < 3; ++i)
+						if (mTriangles[3 * t + i] != vertex)
+							neighbors.push_back(mTriangles[3 * t + i]);
+
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		}
+
+		bool canCollapse(unsigned v0, unsigned v1, const Vector3& target)
+		{
+			//Link condition: the vertices may only share the neighbors of the triangles around the edge, or the mesh pinches
+			auto sharedTriangles = 0u;
+			for (const auto t : mVertexTriangles[v0])
+				if (mAlive[t] && (mTriangles[3 * t] == v1 || mTriangles[3 * t + 1] == v1 || mTriangles[3 * t + 2] == v1))
+					++sharedTriangles;
+
+			getNeighbors(v0, mNeighbors0);
+			getNeighbors(v1, mNeighbors1);
+			std::vector<unsigned> shared;
+			std::set_intersection(mNeighbors0.begin(), mNeighbors0.end(), mNeighbors1.begin(), mNeighbors1.end(), std::back_inserter(shared));
+			if (shared.size() != sharedTriangles)
+				return false;
+
+			//The triangles that stay must not flip or fold
+			for (const auto vertex : { v0, v1 })
+				for (const auto t : mVertexTriangles[vertex])
+				{
+					const auto corners = &mTriangles[3 * t];
+					if (!mAlive[t] || std::find(corners, corners + 3, vertex == v0 ? v1 : v0) != corners + 3)
+						continue;
+
+					Vector3 before[3], after[3];
+					for (auto i = 0u; i < 3; ++i)
+					{
+						before[i] = mPositions[corners[i]];
+						after[i] = corners[i] == vertex ? target : before[i];
+					}
+
+					const auto oldNormal = (before[1] - before[0]).crossProduct(before[2] - before[0]);
+					const auto newNormal = (after[1] - after[0]).crossProduct(after[2] - after[0]);
+					const double oldLength = oldNormal.length();
+					const double newLength = newNormal.length();
+					if (newLength <= 1e-12 * (oldLength + 1e-30))
+						return false;
+					if (oldNormal.dotProduct(newNormal) < minNormalCosine * oldLength * newLength)
+						return false;
+				}
+
+			return true;
+		}
+
+		void apply(unsigned v0, unsigned v1, const Vector3& target)
+		{
+			mPositions[v0] = target;
+			mQuadrics[v0] += mQuadrics[v1];
+			++mVersions[v0];
+			++mVersions[v1];
+
+			//Lists still hold the triangles removed by collapses of other vertices
+			for (const auto t : mVertexTriangles[v1])
+			{
+				if (!mAlive[t]) continue;
+
+				auto corners = &mTriangles[3 * t];
+				if (std::find(corners, corners + 3, v0) != corners + 3)
+				{
+					mAlive[t] = false;
+					--mLiveTriangles;
+					continue;
+				}
+
+				*std::find(corners, corners + 3, v1) = v0;
+				mVertexTriangles[v0].push_back(t);
+			}
+			mVertexTriangles[v1].clear();
+
+			auto& triangles = mVertexTriangles[v0];
+			triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [this](unsigned t) { return !mAlive[t]; }), triangles.end());
+
+			getNeighbors(v0, mNeighbors0);
+			for (const auto neighbor : mNeighbors0)
+				push(v0, neighbor);
+		}
+
+		std::vector<Vector3> mPositions;
+		std::vector<Quadric> mQuadrics;
+		std::vector<unsigned> mVersions;
+		std::vector<unsigned> mTriangles;
+		std::vector<bool> mAlive;
+		std::vector<std::vector<unsigned>> mVertexTriangles;
+		size_t mLiveTriangles;
+		std::priority_queue<Collapse> mQueue;
+
+		///Scratch buffers
+		std::vector<unsigned> mNeighbors0, mNeighbors1;
+	};
+}
+
+MeshSimplifier::MeshSimplifier(size_t targetTriangles, Real maxError) :
+	mTargetTriangles(targetTriangles),
+	mMaxError(maxError),
+	mPreserveBorders(true)
+{
+}
+
+void MeshSimplifier::setTargetTriangles(size_t targetTriangles)
+{
+	mTargetTriangles = targetTriangles;
+}
+
+void MeshSimplifier::setMaxError(Real maxError)
+{
+	mMaxError = maxError;
+}
+
+void MeshSimplifier::setPreserveBorders(bool preserveBorders)
+{
+	mPreserveBorders = preserveBorders;
+}
+
+SimplifyStatistics MeshSimplifier::simplify(std::vector<Vector3>& vertices, std::vector<unsigned>& indices) const
+{
+	SimplifyStatistics statistics;
+	statistics.verticesBefore = vertices.size();
+	statistics.trianglesBefore = indices.size() / 3;
+
+	Simplification simplification(vertices, indices, mPreserveBorders);
+
+	const auto maxCost = mMaxError < std::sqrt(std::numeric_limits<double>::max())
+		? double(mMaxError) * double(mMaxError)
+		: std::numeric_limits<double>::max();
+	statistics.error = Real(std::sqrt(simplification.run(mTargetTriangles, maxCost)));
+
+	simplification.write(vertices, indices);
+	statistics.verticesAfter = vertices.size();
+	statistics.trianglesAfter = indices.size() / 3;
+
+	return statistics;
+}
@@ -0,0 +1,239 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreOrientedBox.cpp
+ *
+ *    Description:  BtOgre oriented bounding box fitting implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreOrientedBox.h"
+#include "BtOgreConvexHull.h"
+#include "BtOgreExtras.h"
+#include "BtOgreVertexKernels.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <OgreMatrix3.h>
+#include <OgreVector2.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Number of times the best box is refined around its own axes
+	const int refineIterations = 3;
+
+	///Get the matrix bringing points in the frame of these axes
+	Matrix4 toAxes(const Vector3 axes[3])
+	{
+		return Matrix4(axes[0].x, axes[0].y, axes[0].z, 0,
+			axes[1].x, axes[1].y, axes[1].z, 0,
+			axes[2].x, axes[2].y, axes[2].z, 0,
+			0, 0, 0, 1);
+	}
+
+	///Project the points on the axes, and get their extents along each of them
+	void project(const Vector3* points, size_t count, const Vector3 axes[3], std::vector<Vector3>& projected, Vector3& minimum, Vector3& maximum)
+	{
+		minimum = Vector3(std::numeric_limits<Real>::max());
+		maximum = Vector3(-std::numeric_limits<Real>::max());
+		projected.resize(count);
+		VertexKernels::transformFloat3(reinterpret_cast<const unsigned char*>(points), sizeof(Vector3), count,
+			toAxes(axes), projected.data(), minimum, maximum);
+	}
+
+	///Compare boxes by volume, then by the sum of their sizes for flat ones
+	bool isSmaller(const Vector3& size, const Vector3& other)
+	{
+		const auto volume = size.x * size.y * size.z;
+		const auto otherVolume = other.x * other.y * other.z;
+		if (volume != otherVolume)
+			return volume < otherVolume;
+		return size.x + size.y + size.z < other.x + other.y + other.z;
+	}
+
+	///Get the convex hull of 2D points, counter clockwise (Andrew's monotone chain)
+	std::vector<Vector2> computeHull2D(std::vector<Vector2> points)
+	{
+		std::sort(points.begin(), points.end(), [](const Vector2& a, const Vector2& b)
+		{
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+		if (points.size() < 3)
+			return points;
+
+		const auto turn = [](const Vector2& o, const Vector2& a, const Vector2& b) { return (a - o).crossProduct(b - o); };
+
+		std::vector<Vector2> hull(2 * points.size());
+		auto k = size_t{ 0 };
+		for (auto i = size_t{ 0 }; i < points.size(); ++i)
+		{
+			while (k >= 2 && turn(hull[k - 2], hull[k - 1], points[i]) <= 0) --k;
+			hull[k++] = points[i];
+		}
+		for (auto i = points.size() - 1, lower = k + 1; i > 0; --i)
+		{
+			while (k >= lower && turn(hull[k - 2], hull[k - 1], points[i - 1]) <= 0) --k;
+			hull[k++] = points[i - 1];
+		}
+		hull.resize(k - 1);
+		return hull;
+	}
+
+	///Get the direction of the smallest rectangle around a convex polygon. One of its sides lies on an edge of the polygon
+	Vector2 getSmallestRectangleDirection(const std::vector<Vector2>& hull)
+	{
+		auto best = Vector2::UNIT_X;
+		auto bestArea = std::numeric_limits<Real>::max();
+
+		for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+		{
+			auto edge = hull[(i + 1) % hull.size()] - hull[i];
+			const auto length = edge.length();
+			if (length <= 0) continue;
+			edge /= length;
+			const Vector2 normal(-edge.y, edge.x);
+
+			auto minimum = Vector2(std::numeric_limits<Real>::max());
+			auto maximum = Vector2(-std::numeric_limits<Real>::max());
+			for (const auto& point : hull)
+			{
+				const Vector2 projected(point.dotProduct(edge), point.dotProduct(normal));
+				minimum.makeFloor(projected);
+				maximum.makeCeil(projected);
+			}
+
+			const auto size = maximum - minimum;
+			if (size.x * size.y < bestArea)
+			{
+				bestArea = size.x * size.y;
+				best = edge;
+			}
+		}
+		return best;
+	}
+
+	///Get the box of these axes spanning these extents
+	OrientedBox makeBox(const Vector3 axes[3], const Vector3& minimum, const Vector3& maximum)
+	{
+		const auto center = 0.5f * (minimum + maximum);
+		return{ center.x * axes[0] + center.y * axes[1] + center.z * axes[2], Quaternion(axes[0], axes[1], axes[2]), 0.5f * (maximum - minimum) };
+	}
+}
+
+Real OrientedBox::getVolume() const
+{
+	return 8 * halfExtents.x * halfExtents.y * halfExtents.z;
+}
+
+btTransform OrientedBox::getTransform() const
+{
+	return btTransform(Convert::toBullet(orientation), Convert::toBullet(center));
+}
+
+btBoxShape* OrientedBox::createShape() const
+{
+	return new btBoxShape(Convert::toBullet(halfExtents));
+}
+
+OrientedBox OrientedBoxFitter::fit(const Vector3* points, size_t count)
+{
+	assert(count && ("There must be points to fit a box around"));
+
+	//Only the vertices of the hull can touch the box. Flat and tiny sets are used as is
+	std::vector<Vector3> hull;
+	if (count > 4)
+		hull = ConvexHullBuilder(std::numeric_limits<unsigned>::max()).computeHull(points, count);
+	if (hull.size() < 4)
+		hull.assign(points, points + count);
+
+	//Principal components of the hull vertices
+	auto mean = Vector3::ZERO;
+	for (const auto& point : hull)
+		mean += point;
+	mean /= Real(hull.size());
+
+	Real xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+	for (const auto& point : hull)
+	{
+		const auto d = point - mean;
+		xx += d.x * d.x; xy += d.x * d.y; xz += d.x * d.z;
+		yy += d.y * d.y; yz += d.y * d.z; zz += d.z * d.z;
+	}
+
+	Real eigenValues[3];
+	Vector3 axes[3];
+	Matrix3(xx, xy, xz, xy, yy, yz, xz, yz, zz).EigenSolveSymmetric(eigenValues, axes);
+
+	//Make the axes orthonormal and right handed, even when eigen values are repeated
+	axes[0].normalise();
+	axes[2] = axes[0].crossProduct(axes[1]);
+	if (axes[2].isZeroLength())
+		axes[2] = axes[0].perpendicular();
+	axes[2].normalise();
+	axes[1] = axes[2].crossProduct(axes[0]);
+
+	std::vector<Vector3> projected, candidateProjected;
+	std::vector<Vector2> plane(hull.size());
+	Vector3 bestMinimum, bestMaximum;
+	project(hull.data(), hull.size(), axes, projected, bestMinimum, bestMaximum);
+
+	Vector3 best[3] = { axes[0], axes[1], axes[2] };
+	for (auto iteration = 0; iteration < refineIterations; ++iteration)
+	{
+		//Keep each axis in turn, and fit the smallest rectangle in the plane of the two others
+		const Vector3 current[3] = { best[0], best[1], best[2] };
+		auto improved = false;
+		for (auto k = 0; k < 3; ++k)
+		{
+			const auto u = (k + 1) % 3;
+			const auto v = (k + 2) % 3;
+			for (auto i = size_t{ 0 }; i < hull.size(); ++i)
+				plane[i] = Vector2(projected[i][u], projected[i][v]);
+
+			const auto direction = getSmallestRectangleDirection(computeHull2D(plane));
+			Vector3 candidate[3];
+			candidate[k] = current[k];
+			candidate[u] = direction.x * current[u] + direction.y * current[v];
+			candidate[v] = -direction.y * current[u] + direction.x * current[v];
+
+			Vector3 minimum, maximum;
+			project(hull.data(), hull.size(), candidate, candidateProjected, minimum, maximum);
+			if (isSmaller(maximum - minimum, bestMaximum - bestMinimum))
+			{
+				std::copy(candidate, candidate + 3, best);
+				bestMinimum = minimum;
+				bestMaximum = maximum;
+				improved = true;
+			}
+		}
+
+		if (!improved)
+			break;
+		project(hull.data(), hull.size(), best, projected, bestMinimum, bestMaximum);
+	}
+
+	return makeBox(best, bestMinimum, bestMaximum);
+}
+
+OrientedBox OrientedBoxFitter::fitAxes(const Vector3* points, size_t count, const Quaternion& orientation)
+{
+	assert(count && ("There must be points to fit a box around"));
+
+	Vector3 axes[3];
+	orientation.ToAxes(axes);
+
+	std::vector<Vector3> projected;
+	Vector3 minimum, maximum;
+	project(points, count, axes, projected, minimum, maximum);
+	return makeBox(axes, minimum, maximum);
+}
@@ -0,0 +1,415 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreQuantizedMesh.cpp
+ *
+ *    Description:  BtOgre quantized triangle mesh implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreQuantizedMesh.h"
+#include "BtOgreMemoryStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+
+#include <LinearMath/btAabbUtil2.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Chunk indices are 16 bits
+	constexpr auto maxChunkVertices = size_t{ 1 } << 16;
+
+	///The quantized BVH keeps the part of each leaf in 10 bits
+	constexpr auto maxQuantizedParts = size_t{ 1 } << 10;
+
+	///Largest quantized coordinate
+	constexpr auto quantizationSteps = Real(std::numeric_limits<uint16_t>::max());
+
+	///Spread the 10 low bits of value so there are 2 zero bits between each of them
+	uint32_t spreadBits(uint32_t value)
+	{
+		value &= 0x3ff;
+		value = (value | (value << 16)) & 0x030000ff;
+		value = (value | (value << 8)) & 0x0300f00f;
+		value = (value | (value << 4)) & 0x030c30c3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	///Position of the point along a Morton curve through the box
+	uint32_t mortonCode(const Vector3& point, const Vector3& minimum, const Vector3& inverseExtent)
+	{
+		const auto cell = [](Real value) { return uint32_t(std::min(std::max(value, Real(0)), Real(1)) * 1023); };
+		const auto relative = (point - minimum) * inverseExtent;
+		return spreadBits(cell(relative.x)) | (spreadBits(cell(relative.y)) << 1) | (spreadBits(cell(relative.z)) << 2);
+	}
+
+	///Forward the triangles of the BVH leaves a query reaches, dequantized
+	struct NodeCallback : btNodeOverlapCallback
+	{
+		NodeCallback(const QuantizedMeshInterface& mesh, btTriangleCallback* callback) :
+			mMesh(mesh),
+			mCallback(callback)
+		{
+		}
+
+		void processNode(int subPart, int triangleIndex) override
+		{
+			btVector3 corners[3];
+			mMesh.getTriangle(subPart, triangleIndex, corners);
+			mCallback->processTriangle(corners, subPart, triangleIndex);
+		}
+
+		const QuantizedMeshInterface& mMesh;
+		btTriangleCallback* mCallback;
+	};
+
+	///Count the triangles a query reports
+	struct CountingCallback : btTriangleCallback
+	{
+		void processTriangle(btVector3*, int, int) override { ++triangles; }
+		size_t triangles = 0;
+	};
+}
+
+QuantizedMeshInterface::QuantizedMeshInterface(const Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+	unsigned maxChunkTriangles) :
+	mMinimum(Vector3::ZERO),
+	mStep(Vector3::ZERO),
+	mMaxError(0)
+{
+	const auto triangleCount = indexCount / 3;
+	if (!triangleCount) return;
+
+	//Rather have bigger chunks than lose the quantized BVH
+	const auto chunkTriangles = std::max(size_t(std::max(maxChunkTriangles, 1u)), (triangleCount + maxQuantizedParts - 1) / maxQuantizedParts);
+
+	//Order the triangles along a Morton curve through the mesh box, so consecutive triangles are close and chunk boxes are small
+	auto minimum = Vector3(std::numeric_limits<Real>::max());
+	auto maximum = Vector3(-std::numeric_limits<Real>::max());
+	for (auto i = size_t{ 0 }; i < 3 * triangleCount; ++i)
+	{
+		minimum.makeFloor(vertices[indices[i]]);
+		maximum.makeCeil(vertices[indices[i]]);
+	}
+
+	const auto extent = maximum - minimum;
+	const auto inverseExtent = Vector3(extent.x > 0 ? 1 / extent.x : 0, extent.y > 0 ? 1 / extent.y : 0, extent.z > 0 ? 1 / extent.z : 0);
+
+	std::vector<std::pair<uint32_t, unsigned>> order(triangleCount);
+	for (auto t = size_t{ 0 }; t < triangleCount; ++t)
+	{
+		const auto triangle = indices + 3 * t;
+		const auto centroid = (vertices[triangle[0]] + vertices[triangle[1]] + vertices[triangle[2]]) / 3;
+		order[t] = { mortonCode(centroid, minimum, inverseExtent), unsigned(t) };
+	}
+	std::sort(order.begin(), order.end());
+
+	//Chunk each vertex was last added to, and its index there. The vertices of every chunk, one chunk after the other
+	std::vector<size_t> chunkOf(vertexCount, std::numeric_limits<size_t>::max());
+	std::vector<uint16_t> localIndex(vertexCount);
+	std::vector<unsigned> chunkVertices;
+	auto firstVertex = size_t{ 0 };
+	auto firstIndex = size_t{ 0 };
+
+	mIndices.reserve(3 * triangleCount);
+
+	const auto closeChunk = [&]
+	{
+		mChunks.push_back(Chunk{ firstVertex, unsigned(chunkVertices.size() - firstVertex), firstIndex, unsigned((mIndices.size() - firstIndex) / 3),
+			{ 0, 0, 0 }, { 0, 0, 0 } });
+		firstVertex = chunkVertices.size();
+		firstIndex = mIndices.size();
+	};
+
+	for (const auto& entry : order)
+	{
+		const auto triangle = indices + 3 * size_t(entry.second);
+		const auto chunk = mChunks.size();
+
+		auto newVertices = size_t{ 0 };
+		for (auto i = 0; i < 3; ++i)
+			if (chunkOf[triangle[i]] != chunk) ++newVertices;
+
+		if (mIndices.size() - firstIndex == 3 * chunkTriangles || chunkVertices.size() - firstVertex + newVertices > maxChunkVertices)
+			closeChunk();
+
+		for (auto i = 0; i < 3; ++i)
+		{
+			const auto vertex = triangle[i];
+			if (chunkOf[vertex] != mChunks.size())
+			{
+				chunkOf[vertex] = mChunks.size();
+				localIndex[vertex] = uint16_t(chunkVertices.size() - firstVertex);
+				chunkVertices.push_back(vertex);
+			}
+			mIndices.push_back(localIndex[vertex]);
+		}
+	}
+	closeChunk();
+
+	//One grid for every chunk, with a step that fits the largest one in 16 bits. Snapping its origin to the grid can add one step
+	auto largest = Vector3::ZERO;
+	for (const auto& chunk : mChunks)
+	{
+		auto chunkMinimum = Vector3(std::numeric_limits<Real>::max());
+		auto chunkMaximum = Vector3(-std::numeric_limits<Real>::max());
+		for (auto v = chunk.firstVertex; v < chunk.firstVertex + chunk.vertexCount; ++v)
+		{
+			chunkMinimum.makeFloor(vertices[chunkVertices[v]]);
+			chunkMaximum.makeCeil(vertices[chunkVertices[v]]);
+		}
+		largest.makeCeil(chunkMaximum - chunkMinimum);
+	}
+
+	//Chunks flat along an axis, like the steps of a staircase, still need a grid to be placed along it
+	for (auto axis = 0; axis < 3; ++axis)
+		if (largest[axis] <= 0) largest[axis] = extent[axis];
+
+	mMinimum = minimum;
+	mStep = largest / (quantizationSteps - 1);
+
+	//Grid point of a vertex, the same whatever chunk it's in
+	const auto gridPoint = [&](unsigned vertex, int axis)
+	{
+		return mStep[axis] > 0 ? uint32_t(std::llround((vertices[vertex][axis] - mMinimum[axis]) / mStep[axis])) : uint32_t(0);
+	};
+
+	mPositions.reserve(3 * chunkVertices.size());
+	for (auto& chunk : mChunks)
+	{
+		chunk.origin[0] = chunk.origin[1] = chunk.origin[2] = std::numeric_limits<uint32_t>::max();
+		for (auto v = chunk.firstVertex; v < chunk.firstVertex + chunk.vertexCount; ++v)
+		{
+			for (auto axis = 0; axis < 3; ++axis)
+				chunk.origin[axis] = std::min(chunk.origin[axis], gridPoint(chunkVertices[v], axis));
+		}
+
+		for (auto v = chunk.firstVertex; v < chunk.firstVertex + chunk.vertexCount; ++v)
+		{
+			const auto vertex = chunkVertices[v];
+			uint16_t quantized[3];
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				quantized[axis] = uint16_t(std::min(gridPoint(vertex, axis) - chunk.origin[axis], uint32_t(quantizationSteps)));
+				chunk.size[axis] = std::max(chunk.size[axis], quantized[axis]);
+				mPositions.push_back(quantized[axis]);
+			}
+			const auto& position = vertices[vertex];
+			mMaxError = std::max(mMaxError, Real(dequantize(chunk, quantized).distance(btVector3(btScalar(position.x), btScalar(position.y), btScalar(position.z)))));
+		}
+	}
+
+	mPositions.shrink_to_fit();
+	mChunks.shrink_to_fit();
+}
+
+void QuantizedMeshInterface::getTriangle(int chunk, int triangle, btVector3* corners) const
+{
+	const auto& part = mChunks[size_t(chunk)];
+	const auto index = &mIndices[part.firstIndex + 3 * size_t(triangle)];
+	for (auto i = 0; i < 3; ++i)
+	{
+		corners[i] = dequantize(part, &mPositions[3 * (part.firstVertex + index[i])]) * m_scaling;
+	}
+}
+
+size_t QuantizedMeshInterface::getMemoryUsage() const
+{
+	return mChunks.capacity() * sizeof(Chunk) + (mPositions.capacity() + mIndices.capacity()) * sizeof(uint16_t);
+}
+
+btVector3 QuantizedMeshInterface::dequantize(const Chunk& chunk, const uint16_t* quantized) const
+{
+	//From the grid point, in double: a vertex shared by several chunks gives the same bits in each, however far it is from the minimum
+	const auto axis = [&](int i) { return btScalar(double(mMinimum[i]) + double(chunk.origin[i] + quantized[i]) * double(mStep[i])); };
+	return btVector3(axis(0), axis(1), axis(2));
+}
+
+void QuantizedMeshInterface::getChunkAabb(const Chunk& chunk, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	const uint16_t origin[3] = { 0, 0, 0 };
+	const auto first = dequantize(chunk, origin) * m_scaling;
+	const auto last = dequantize(chunk, chunk.size) * m_scaling;
+
+	//The scaling can be negative
+	aabbMin = first;
+	aabbMin.setMin(last);
+	aabbMax = first;
+	aabbMax.setMax(last);
+}
+
+void QuantizedMeshInterface::InternalProcessAllTriangles(btInternalTriangleIndexCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	btVector3 corners[3];
+	for (auto chunk = 0; chunk < int(mChunks.size()); ++chunk)
+	{
+		//A chunk outside of the box has no triangle in it
+		btVector3 chunkMin, chunkMax;
+		getChunkAabb(mChunks[size_t(chunk)], chunkMin, chunkMax);
+		if (!TestAabbAgainstAabb2(chunkMin, chunkMax, aabbMin, aabbMax)) continue;
+
+		for (auto triangle = 0; triangle < int(mChunks[size_t(chunk)].triangleCount); ++triangle)
+		{
+			getTriangle(chunk, triangle, corners);
+			callback->internalProcessTriangleIndex(corners, chunk, triangle);
+		}
+	}
+}
+
+void QuantizedMeshInterface::getLockedVertexIndexBase(unsigned char** vertexBase, int& vertexCount, PHY_ScalarType& type, int& stride,
+	unsigned char** indexBase, int& indexStride, int& faceCount, PHY_ScalarType& indexType, int subpart)
+{
+	const unsigned char* constVertexBase;
+	const unsigned char* constIndexBase;
+	getLockedReadOnlyVertexIndexBase(&constVertexBase, vertexCount, type, stride, &constIndexBase, indexStride, faceCount, indexType, subpart);
+
+	*vertexBase = const_cast<unsigned char*>(constVertexBase);
+	*indexBase = const_cast<unsigned char*>(constIndexBase);
+}
+
+void QuantizedMeshInterface::getLockedReadOnlyVertexIndexBase(const unsigned char** vertexBase, int& vertexCount, PHY_ScalarType& type, int& stride,
+	const unsigned char** indexBase, int& indexStride, int& faceCount, PHY_ScalarType& indexType, int subpart) const
+{
+	const auto& chunk = mChunks[size_t(subpart)];
+
+	*vertexBase = reinterpret_cast<const unsigned char*>(mPositions.data() + 3 * chunk.firstVertex);
+	vertexCount = int(chunk.vertexCount);
+	type = PHY_SHORT;
+	stride = 3 * sizeof(uint16_t);
+
+	*indexBase = reinterpret_cast<const unsigned char*>(mIndices.data() + chunk.firstIndex);
+	indexStride = 3 * sizeof(uint16_t);
+	faceCount = int(chunk.triangleCount);
+	indexType = PHY_SHORT;
+}
+
+void QuantizedMeshInterface::getPremadeAabb(btVector3* aabbMin, btVector3* aabbMax) const
+{
+	if (mChunks.empty())
+	{
+		aabbMin->setZero();
+		aabbMax->setZero();
+		return;
+	}
+
+	aabbMin->setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	aabbMax->setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	for (const auto& chunk : mChunks)
+	{
+		btVector3 chunkMin, chunkMax;
+		getChunkAabb(chunk, chunkMin, chunkMax);
+		aabbMin->setMin(chunkMin);
+		aabbMax->setMax(chunkMax);
+	}
+}
+
+detail::QuantizedMeshStorage::QuantizedMeshStorage(const Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+	unsigned maxChunkTriangles, const btVector3& scaling) :
+	mQuantizedMesh(vertices, vertexCount, indices, indexCount, maxChunkTriangles)
+{
+	mQuantizedMesh.setScaling(scaling);
+}
+
+QuantizedBvhTriangleMeshShape::QuantizedBvhTriangleMeshShape(const Vector3* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount,
+	const btVector3& scaling, unsigned maxChunkTriangles) :
+	QuantizedMeshStorage(vertices, vertexCount, indices, indexCount, maxChunkTriangles, scaling),
+	btTriangleMeshShape(&mQuantizedMesh),
+	mBvh(nullptr)
+{
+	//Not a btBvhTriangleMeshShape: the collision world must not take the shortcuts it has for those
+	m_shapeType = CUSTOM_CONCAVE_SHAPE_TYPE;
+	buildBvh();
+}
+
+QuantizedBvhTriangleMeshShape::~QuantizedBvhTriangleMeshShape()
+{
+	mBvh->~btOptimizedBvh();
+	btAlignedFree(mBvh);
+}
+
+void QuantizedBvhTriangleMeshShape::buildBvh()
+{
+	if (mBvh)
+	{
+		mBvh->~btOptimizedBvh();
+		btAlignedFree(mBvh);
+	}
+
+	mBvh = new (btAlignedAlloc(sizeof(btOptimizedBvh), 16)) btOptimizedBvh();
+
+	//Chunks that hit the 65536 vertices limit can make more parts than the quantized nodes can address
+	const auto useQuantizedAabbCompression = size_t(mQuantizedMesh.getNumSubParts()) <= maxQuantizedParts;
+	mBvh->build(&mQuantizedMesh, useQuantizedAabbCompression, m_localAabbMin, m_localAabbMax);
+}
+
+void QuantizedBvhTriangleMeshShape::processAllTriangles(btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+	NodeCallback nodeCallback(mQuantizedMesh, callback);
+	mBvh->reportAabbOverlappingNodex(&nodeCallback, aabbMin, aabbMax);
+}
+
+void QuantizedBvhTriangleMeshShape::performRaycast(btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget) const
+{
+	NodeCallback nodeCallback(mQuantizedMesh, callback);
+	mBvh->reportRayOverlappingNodex(&nodeCallback, raySource, rayTarget);
+}
+
+void QuantizedBvhTriangleMeshShape::performConvexcast(btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget,
+	const btVector3& boxMin, const btVector3& boxMax) const
+{
+	NodeCallback nodeCallback(mQuantizedMesh, callback);
+	mBvh->reportBoxCastOverlappingNodex(&nodeCallback, boxSource, boxTarget, boxMin, boxMax);
+}
+
+void QuantizedBvhTriangleMeshShape::setLocalScaling(const btVector3& scaling)
+{
+	if ((getLocalScaling() - scaling).length2() <= SIMD_EPSILON) return;
+
+	mQuantizedMesh.setScaling(scaling);
+	mQuantizedMesh.getPremadeAabb(&m_localAabbMin, &m_localAabbMax);
+	buildBvh();
+}
+
+size_t QuantizedBvhTriangleMeshShape::getMemoryUsage() const
+{
+	return MemoryStats::measureShape(this).getTotal();
+}
+
+QueryThroughput QueryBenchmark::measure(const btConcaveShape* shape, size_t queryCount, Real querySize, unsigned seed)
+{
+	btTransform identity;
+	identity.setIdentity();
+	btVector3 aabbMin, aabbMax;
+	shape->getAabb(identity, aabbMin, aabbMax);
+
+	//Generate the boxes first, only the queries are timed
+	const auto halfSize = btVector3(1, 1, 1) * btScalar((aabbMax - aabbMin).length() * querySize / 2);
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<btScalar> unit(0, 1);
+	btAlignedObjectArray<btVector3> centers;
+	centers.resize(int(queryCount));
+	for (auto i = 0; i < centers.size(); ++i)
+		centers[i] = aabbMin + (aabbMax - aabbMin) * btVector3(unit(random), unit(random), unit(random));
+
+	CountingCallback counter;
+	const auto start = std::chrono::steady_clock::now();
+	for (auto i = 0; i < centers.size(); ++i)
+		shape->processAllTriangles(&counter, centers[i] - halfSize, centers[i] + halfSize);
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return { seconds > 0 ? double(queryCount) / seconds : 0, queryCount ? double(counter.triangles) / double(queryCount) : 0 };
+}
@@ -0,0 +1,406 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreShapeCache.cpp
+ *
+ *    Description:  BtOgre collision shape cache implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreShapeCache.h"
+#include "BtOgreInternal.h"
+
+#include <BulletCollision/CollisionShapes/btConvexPointCloudShape.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btUniformScalingShape.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+using detail::log;
+
+namespace
+{
+	///Create a copy of a primitive shape, to apply a non uniform scale to it. nullptr for other shapes
+	btCollisionShape* clonePrimitive(const btCollisionShape* shape)
+	{
+		switch (shape->getShapeType())
+		{
+		case SPHERE_SHAPE_PROXYTYPE:
+			return new btSphereShape(static_cast<const btSphereShape*>(shape)->getRadius());
+
+		case BOX_SHAPE_PROXYTYPE:
+			return new btBoxShape(static_cast<const btBoxShape*>(shape)->getHalfExtentsWithMargin());
+
+		case CYLINDER_SHAPE_PROXYTYPE:
+		{
+			const auto cylinder = static_cast<const btCylinderShape*>(shape);
+			const auto halfExtents = cylinder->getHalfExtentsWithMargin();
+			if (cylinder->getUpAxis() == 0) return new btCylinderShapeX(halfExtents);
+			if (cylinder->getUpAxis() == 2) return new btCylinderShapeZ(halfExtents);
+			return new btCylinderShape(halfExtents);
+		}
+
+		case CAPSULE_SHAPE_PROXYTYPE:
+		{
+			const auto capsule = static_cast<const btCapsuleShape*>(shape);
+			if (capsule->getUpAxis() == 0) return new btCapsuleShapeX(capsule->getRadius(), 2 * capsule->getHalfHeight());
+			if (capsule->getUpAxis() == 2) return new btCapsuleShapeZ(capsule->getRadius(), 2 * capsule->getHalfHeight());
+			return new btCapsuleShape(capsule->getRadius(), 2 * capsule->getHalfHeight());
+		}
+
+		default:
+			return nullptr;
+		}
+	}
+
+	///Points on the surface of a convex shape, in its frame and with its scaling. The points of a hull, or the support points of a
+	///primitive in directions spread over the sphere: exact for boxes, a polygonal approximation of round shapes
+	std::vector<btVector3> getSurfacePoints(const btConvexShape* shape)
+	{
+		std::vector<btVector3> points;
+		if (shape->getShapeType() == CONVEX_HULL_SHAPE_PROXYTYPE)
+		{
+			const auto hull = static_cast<const btConvexHullShape*>(shape);
+			for (auto i = 0; i < hull->getNumPoints(); ++i)
+				points.push_back(hull->getScaledPoint(i));
+			return points;
+		}
+
+		//The radius of spheres and capsules is their margin, the other shapes are inside theirs
+		const auto roundShape = shape->getShapeType() == SPHERE_SHAPE_PROXYTYPE || shape->getShapeType() == CAPSULE_SHAPE_PROXYTYPE;
+		const auto support = [&](const btVector3& direction)
+		{
+			return roundShape ? shape->localGetSupportingVertex(direction) : shape->localGetSupportingVertexWithoutMargin(direction);
+		};
+
+		const auto latitudes = 8, longitudes = 16;
+		points.push_back(support(btVector3(0, 1, 0)));
+		points.push_back(support(btVector3(0, -1, 0)));
+		for (auto i = 1; i < latitudes; ++i)
+		{
+			const auto polar = SIMD_PI * btScalar(i) / latitudes;
+			for (auto j = 0; j < longitudes; ++j)
+			{
+				const auto azimuth = SIMD_2_PI * (btScalar(j) + btScalar(0.5)) / longitudes;
+				points.push_back(support(btVector3(btSin(polar) * btCos(azimuth), btCos(polar), btSin(polar) * btSin(azimuth))));
+			}
+		}
+		return points;
+	}
+
+	///Hull of a convex shape rotated by basis, then scaled. For the children of a compound whose rotation doesn't commute with
+	///a non uniform scale
+	btConvexHullShape* bakeScaledHull(const btConvexShape* shape, const btMatrix3x3& basis, const btVector3& scaling)
+	{
+		const auto hull = new btConvexHullShape;
+		for (const auto& point : getSurfacePoints(shape))
+			hull->addPoint(scaling * (basis * point), false);
+		hull->recalcLocalAabb();
+		hull->initializePolyhedralFeatures();
+		return hull;
+	}
+
+	///Delete a shape, and the children of a compound
+	void deleteShape(btCollisionShape* shape)
+	{
+		if (shape && shape->isCompound())
+		{
+			const auto compound = static_cast<btCompoundShape*>(shape);
+			for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+				deleteShape(compound->getChildShape(i));
+		}
+		delete shape;
+	}
+}
+
+ShapeCache::ShapeCache(size_t memoryBudget) :
+	mMemoryBudget(memoryBudget),
+	mMemoryUsage(0),
+	mHits(0),
+	mMisses(0),
+	mEvictions(0)
+{
+}
+
+ShapeCache& ShapeCache::getSingleton()
+{
+	static ShapeCache cache;
+	return cache;
+}
+
+bool ShapeCache::Key::operator==(const Key& other) const
+{
+	return kind == other.kind && transformHash == other.transformHash && meshName == other.meshName && skeletonSettings == other.skeletonSettings;
+}
+
+size_t ShapeCache::KeyHash::operator()(const Key& key) const
+{
+	auto hash = std::hash<std::string>()(key.meshName);
+	hash ^= key.transformHash + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= size_t(key.kind) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= key.skeletonSettings.hash() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+size_t ShapeCache::hashTransform(const Matrix4& transform)
+{
+	//FNV-1a on the bytes of the matrix
+	auto hash = uint64_t{ 14695981039346656037ULL };
+	const auto bytes = reinterpret_cast<const unsigned char*>(transform[0]);
+	for (auto i = size_t{ 0 }; i < 16 * sizeof(Real); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return size_t(hash);
+}
+
+SharedShape ShapeCache::getShape(Item* item, ShapeKind kind, const Matrix4& transform)
+{
+	const auto node = item->getParentNode();
+	return getShape(item->getMesh().get(), kind, transform, node ? node->getScale() : Vector3::UNIT_SCALE);
+}
+
+SharedShape ShapeCache::getShape(const Mesh* mesh, ShapeKind kind, const Matrix4& transform, const Vector3& scale)
+{
+	const auto shape = getUnscaledShape({ mesh->getName(), kind, hashTransform(transform), SkeletonShapeSettings() }, [&]
+	{
+		StaticMeshToShapeConverter converter;
+		converter.addMesh(mesh, transform);
+		return converter.createShape(kind);
+	});
+
+	return createScaledInstance(shape, scale);
+}
+
+SharedShape ShapeCache::getShape(v1::Entity* entity, ShapeKind kind, const Matrix4& transform)
+{
+	const auto node = entity->getParentNode();
+	return getShape(entity->getMesh().get(), kind, transform, node ? node->getScale() : Vector3::UNIT_SCALE);
+}
+
+SharedShape ShapeCache::getShape(const v1::Mesh* mesh, ShapeKind kind, const Matrix4& transform, const Vector3& scale)
+{
+	//v1 and v2 meshes live in different managers and can have the same name
+	const auto shape = getUnscaledShape({ "v1/" + mesh->getName(), kind, hashTransform(transform), SkeletonShapeSettings() }, [&]
+	{
+		StaticMeshToShapeConverter converter;
+		converter.addMesh(mesh, transform);
+		return converter.createShape(kind);
+	});
+
+	return createScaledInstance(shape, scale);
+}
+
+SharedShape ShapeCache::getSkeletonShape(const v1::MeshPtr& mesh, const SkeletonShapeSettings& settings)
+{
+	//Always built in the binding pose, without transform
+	return getUnscaledShape({ "v1/" + mesh->getName(), ShapeKind::Skeleton, hashTransform(Matrix4::IDENTITY), settings }, [&]
+	{
+		AnimatedMeshToShapeConverter converter;
+		converter.addMesh(mesh, Matrix4::IDENTITY);
+		return converter.createSkeletonShape(settings);
+	});
+}
+
+SharedShape ShapeCache::getSkeletonShape(v1::Entity* entity, const SkeletonShapeSettings& settings)
+{
+	return getSkeletonShape(entity->getMesh(), settings);
+}
+
+SharedShape ShapeCache::getUnscaledShape(const Key& key, const std::function<btCollisionShape*()>& build)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		const auto found = mIndex.find(key);
+		if (found != mIndex.end())
+		{
+			++mHits;
+			//Move it to the front of the LRU list
+			mEntries.splice(mEntries.begin(), mEntries, found->second);
+			return found->second->shape;
+		}
+		++mMisses;
+	}
+
+	//Don't hold the lock while reading back and building the shape
+	const auto shape = SharedShape(build(), deleteShape);
+	const auto size = estimateShapeSize(shape.get());
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	//Another thread may have built the same shape in the meantime, share theirs
+	const auto found = mIndex.find(key);
+	if (found != mIndex.end())
+	{
+		mEntries.splice(mEntries.begin(), mEntries, found->second);
+		return found->second->shape;
+	}
+
+	mEntries.push_front({ key, shape, size });
+	mIndex[key] = mEntries.begin();
+	mMemoryUsage += size;
+	evict();
+
+	return shape;
+}
+
+SharedShape ShapeCache::createScaledInstance(const SharedShape& shape, const Vector3& scale)
+{
+	if (!shape || scale == Vector3::UNIT_SCALE)
+		return shape;
+
+	const auto scaling = Convert::toBullet(scale);
+	const auto uniform = scale.x == scale.y && scale.y == scale.z;
+	btCollisionShape* instance;
+
+	if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+	{
+		instance = new btScaledBvhTriangleMeshShape(static_cast<btBvhTriangleMeshShape*>(shape.get()), scaling);
+	}
+	else if (shape->isCompound())
+	{
+		//Scaling a compound scales its children: give it instances of them, at scaled positions
+		const auto compound = static_cast<btCompoundShape*>(shape.get());
+		const auto scaled = new btCompoundShape(true, compound->getNumChildShapes());
+		std::vector<SharedShape> children;
+		for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+		{
+			auto transform = compound->getChildTransform(i);
+			const auto child = compound->getChildShape(i);
+
+			if (!uniform && !(transform.getBasis() == btMatrix3x3::getIdentity()))
+			{
+				//A non uniform scale doesn't commute with the rotation of the child (oriented boxes, bones...): bake a scaled copy of it
+				if (!child->isConvex())
+				{
+					log("ShapeCache : can't scale a rotated " + std::string(child->getName()) + " child of a compound non uniformly, the shape is used unscaled");
+					delete scaled;
+					return shape;
+				}
+				children.push_back(SharedShape(bakeScaledHull(static_cast<const btConvexShape*>(child), transform.getBasis(), scaling)));
+				transform.setBasis(btMatrix3x3::getIdentity());
+			}
+			else
+			{
+				//Shares ownership with the compound: the instances keep it alive
+				children.push_back(createScaledInstance(SharedShape(shape, child), scale));
+			}
+
+			transform.setOrigin(transform.getOrigin() * scaling);
+			scaled->addChildShape(transform, children.back().get());
+		}
+		return SharedShape(scaled, [children](btCollisionShape* compoundInstance) { delete compoundInstance; });
+	}
+	else if (shape->isConvex() && uniform)
+	{
+		instance = new btUniformScalingShape(static_cast<btConvexShape*>(shape.get()), scale.x);
+	}
+	else if (shape->getShapeType() == CONVEX_HULL_SHAPE_PROXYTYPE)
+	{
+		//Bullet has no non uniform wrapper for convex shapes, but a point cloud reads the cached hull's points with its own scaling.
+		//The polyhedral features (for SAT contact clipping) depend on the scale, so the instance gets its own if the hull has them
+		const auto hull = static_cast<btConvexHullShape*>(shape.get());
+		const auto pointCloud = new btConvexPointCloudShape(hull->getUnscaledPoints(), hull->getNumPoints(), scaling);
+		if (hull->getConvexPolyhedron())
+			pointCloud->initializePolyhedralFeatures();
+		instance = pointCloud;
+	}
+	else if (const auto copy = clonePrimitive(shape.get()))
+	{
+		//Primitives have no data to share, a scaled copy is as small as a wrapper
+		copy->setLocalScaling(scaling);
+		return SharedShape(copy);
+	}
+	else
+	{
+		log("ShapeCache : no scaled instance for shape type " + std::to_string(shape->getShapeType()) + ", the shape is used unscaled");
+		return shape;
+	}
+
+	//The wrapper points to the cached shape: keep it alive as long as the wrapper lives
+	const auto base = shape;
+	return SharedShape(instance, [base](btCollisionShape* scaled) { delete scaled; });
+}
+
+void ShapeCache::evict()
+{
+	if (mMemoryBudget == 0) return;
+
+	//Always keep the most recently used shape, even if it alone is over budget
+	while (mMemoryUsage > mMemoryBudget && mEntries.size() > 1)
+	{
+		const auto& last = mEntries.back();
+		mMemoryUsage -= last.size;
+		mIndex.erase(last.key);
+		mEntries.pop_back();
+		++mEvictions;
+	}
+}
+
+void ShapeCache::setMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mMemoryBudget = bytes;
+	evict();
+}
+
+size_t ShapeCache::getMemoryBudget() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMemoryBudget;
+}
+
+size_t ShapeCache::getMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMemoryUsage;
+}
+
+size_t ShapeCache::getEntryCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+size_t ShapeCache::getHitCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mHits;
+}
+
+size_t ShapeCache::getMissCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMisses;
+}
+
+size_t ShapeCache::getEvictionCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEvictions;
+}
+
+void ShapeCache::resetCounters()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mHits = mMisses = mEvictions = 0;
+}
+
+void ShapeCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mIndex.clear();
+	mEntries.clear();
+	mMemoryUsage = 0;
+}
+
+size_t ShapeCache::estimateShapeSize(const btCollisionShape* shape)
+{
+	return MemoryStats::measureShape(shape).getTotal();
+}
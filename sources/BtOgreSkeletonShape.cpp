@@ -0,0 +1,169 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreSkeletonShape.cpp
+ *
+ *    Description:  BtOgre bone shape fitting implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreSkeletonShape.h"
+#include "BtOgreConvexHull.h"
+#include "BtOgreOrientedBox.h"
+#include "BtOgreExtras.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	void hashCombine(size_t& hash, size_t value)
+	{
+		hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	btCollisionShape* fitBox(const Vector3& minimum, const Vector3& maximum, btTransform& offset)
+	{
+		const auto halfExtents = 0.5f * (maximum - minimum);
+		if (halfExtents == Vector3::ZERO)
+			return nullptr;
+
+		offset.setIdentity();
+		offset.setOrigin(Convert::toBullet(0.5f * (minimum + maximum)));
+		return new btBoxShape(Convert::toBullet(halfExtents));
+	}
+
+	btCollisionShape* fitCapsule(const Vector3* points, size_t count, const Vector3& minimum, const Vector3& maximum, btTransform& offset)
+	{
+		//The capsule goes along the longest side of the box, through its center
+		const auto center = 0.5f * (minimum + maximum);
+		const auto size = maximum - minimum;
+		const auto axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+
+		//The radius reaches the farthest point from the axis
+		auto radius = Real(0);
+		for (auto i = size_t{ 0 }; i < count; ++i)
+		{
+			auto fromAxis = points[i] - center;
+			fromAxis[axis] = 0;
+			radius = std::max(radius, fromAxis.squaredLength());
+		}
+		radius = std::sqrt(radius);
+		if (radius <= 0)
+			return nullptr;
+
+		//The cylinder part is just long enough for the caps to contain every point
+		auto halfHeight = Real(0);
+		for (auto i = size_t{ 0 }; i < count; ++i)
+		{
+			auto fromAxis = points[i] - center;
+			const auto along = std::abs(fromAxis[axis]);
+			fromAxis[axis] = 0;
+			const auto cap = std::sqrt(std::max(Real(0), radius * radius - fromAxis.squaredLength()));
+			halfHeight = std::max(halfHeight, along - cap);
+		}
+
+		offset.setIdentity();
+		offset.setOrigin(Convert::toBullet(center));
+		if (axis == 0) return new btCapsuleShapeX(radius, 2 * halfHeight);
+		if (axis == 2) return new btCapsuleShapeZ(radius, 2 * halfHeight);
+		return new btCapsuleShape(radius, 2 * halfHeight);
+	}
+
+	btCollisionShape* fitCylinder(const Vector3* points, size_t count, const Vector3& minimum, const Vector3& maximum, btTransform& offset)
+	{
+		//The cylinder goes along the longest side of the box, through its center, and reaches the farthest point from its axis
+		const auto center = 0.5f * (minimum + maximum);
+		const auto size = maximum - minimum;
+		const auto axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+
+		auto radius = Real(0);
+		for (auto i = size_t{ 0 }; i < count; ++i)
+		{
+			auto fromAxis = points[i] - center;
+			fromAxis[axis] = 0;
+			radius = std::max(radius, fromAxis.squaredLength());
+		}
+		radius = std::sqrt(radius);
+		if (radius <= 0)
+			return nullptr;
+
+		auto halfExtents = Vector3(radius);
+		halfExtents[axis] = 0.5f * size[axis];
+
+		offset.setIdentity();
+		offset.setOrigin(Convert::toBullet(center));
+		if (axis == 0) return new btCylinderShapeX(Convert::toBullet(halfExtents));
+		if (axis == 2) return new btCylinderShapeZ(Convert::toBullet(halfExtents));
+		return new btCylinderShape(Convert::toBullet(halfExtents));
+	}
+}
+
+size_t SkeletonShapeSettings::hash() const
+{
+	auto hash = size_t(primitive);
+	hashCombine(hash, minVertices);
+	hashCombine(hash, size_t(includeBoneOrigin));
+	hashCombine(hash, size_t(hullVertexBudget));
+	for (const auto& bone : bonePrimitives)
+	{
+		hashCombine(hash, std::hash<std::string>()(bone.first));
+		hashCombine(hash, size_t(bone.second));
+	}
+	return hash;
+}
+
+bool SkeletonShapeSettings::operator==(const SkeletonShapeSettings& other) const
+{
+	return primitive == other.primitive && bonePrimitives == other.bonePrimitives && minVertices == other.minVertices
+		&& includeBoneOrigin == other.includeBoneOrigin && hullVertexBudget == other.hullVertexBudget;
+}
+
+btCollisionShape* BoneShapeFitter::fit(BonePrimitive primitive, const Vector3* points, size_t count,
+	unsigned hullVertexBudget, btTransform& offset)
+{
+	if (primitive == BonePrimitive::None || !count)
+		return nullptr;
+
+	if (primitive == BonePrimitive::Convex)
+	{
+		if (count < 4)
+			return nullptr;
+
+		offset.setIdentity();
+		return ConvexHullBuilder(hullVertexBudget).build(points, count);
+	}
+
+	if (primitive == BonePrimitive::FittedBox)
+	{
+		const auto box = OrientedBoxFitter::fit(points, count);
+		if (box.halfExtents == Vector3::ZERO)
+			return nullptr;
+
+		offset = box.getTransform();
+		return box.createShape();
+	}
+
+	auto minimum = points[0];
+	auto maximum = points[0];
+	for (auto i = size_t{ 1 }; i < count; ++i)
+	{
+		minimum.makeFloor(points[i]);
+		maximum.makeCeil(points[i]);
+	}
+
+	if (primitive == BonePrimitive::Capsule)
+		return fitCapsule(points, count, minimum, maximum, offset);
+	if (primitive == BonePrimitive::Cylinder)
+		return fitCylinder(points, count, minimum, maximum, offset);
+	return fitBox(minimum, maximum, offset);
+}
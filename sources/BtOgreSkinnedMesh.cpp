@@ -0,0 +1,301 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreSkinnedMesh.cpp
+ *
+ *    Description:  BtOgre skinned collision mesh implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreSkinnedMesh.h"
+#include "BtOgreInternal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <OgreBitwise.h>
+
+#include <BulletCollision/Gimpact/btGImpactShape.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+using detail::Clock;
+using detail::log;
+using detail::makeEmptyBounds;
+using detail::millisecondsSince;
+
+namespace
+{
+	///Vertices skinned by each task of the pool
+	const size_t skinChunkSize = 4096;
+
+	///Read count blend weights of this type as floats. False if the type isn't one meshes store weights in
+	bool readWeights(const unsigned char* data, VertexElementType type, size_t count, float* weights)
+	{
+		switch (type)
+		{
+		case VET_FLOAT1:
+		case VET_FLOAT2:
+		case VET_FLOAT3:
+		case VET_FLOAT4:
+			std::memcpy(weights, data, count * sizeof(float));
+			return true;
+		case VET_HALF2:
+		case VET_HALF4:
+		{
+			uint16 halves[4];
+			std::memcpy(halves, data, count * sizeof(uint16));
+			for (auto k = size_t{ 0 }; k < count; ++k)
+				weights[k] = Bitwise::halfToFloat(halves[k]);
+			return true;
+		}
+		case VET_UBYTE4_NORM:
+			for (auto k = size_t{ 0 }; k < count; ++k)
+				weights[k] = data[k] / 255.0f;
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+SkinnedCollisionMesh::SkinnedCollisionMesh(v1::Entity* entity, SkinnedBackend backend, ThreadPool* pool, Real boundsMargin) :
+	mEntity(entity),
+	mBackend(backend),
+	mPool(pool),
+	mBoundsMargin(boundsMargin),
+	mRefitThreshold(0),
+	mLastUpdate{ 0, 0, 0, false }
+{
+	const auto& mesh = entity->getMesh();
+	assert(mesh->hasSkeleton());
+
+	//Binding pose and triangles. The converter adds the vertices in the same order as the influences are read below
+	AnimatedMeshToShapeConverter converter;
+	converter.addMesh(mesh, Matrix4::IDENTITY);
+	mBindingPose.assign(converter.getVertices(), converter.getVertices() + converter.getVertexCount());
+	mIndices.assign(converter.getIndices(), converter.getIndices() + converter.getIndexCount());
+
+	if (mesh->sharedVertexData[0])
+		readInfluences(mesh->sharedVertexData[0], mesh->sharedBlendIndexToBoneIndexMap);
+
+	for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+	{
+		const auto subMesh = mesh->getSubMesh(i);
+		if (!subMesh->useSharedVertices)
+			readInfluences(subMesh->vertexData[0], subMesh->blendIndexToBoneIndexMap);
+	}
+
+	assert(!mBindingPose.empty() && mInfluences.size() == mBindingPose.size() &&
+		("The mesh must have vertices, all of them with blend indices and weights"));
+
+	//Start from the current pose
+	mBoneMatrices.resize(entity->getSkeleton()->getNumBones());
+	mVertices = mBindingPose;
+	readBoneMatrices();
+
+	Vector3 minimum, maximum, movedMinimum, movedMaximum;
+	skin(minimum, maximum, movedMinimum, movedMaximum);
+
+	mMeshInterface.reset(new btTriangleIndexVertexArray(static_cast<int>(mIndices.size() / 3), reinterpret_cast<int*>(mIndices.data()),
+		3 * sizeof(unsigned), static_cast<int>(mVertices.size()), reinterpret_cast<btScalar*>(mVertices.data()), sizeof(Vector3)));
+
+	if (mBackend == SkinnedBackend::GImpact)
+	{
+		const auto shape = new btGImpactMeshShape(mMeshInterface.get());
+		shape->updateBound();
+		mShape.reset(shape);
+	}
+	else
+	{
+		setQuantizationBounds(minimum, maximum);
+		mShape.reset(new btBvhTriangleMeshShape(mMeshInterface.get(), true,
+			Convert::toBullet(mQuantizationMinimum), Convert::toBullet(mQuantizationMaximum)));
+	}
+
+	log("SkinnedCollisionMesh : " + std::to_string(mVertices.size()) + " vertices, " + std::to_string(mIndices.size() / 3) + " triangles, "
+		+ std::to_string(mBoneMatrices.size()) + " bones, " + (mBackend == SkinnedBackend::GImpact ? "GImpact" : "BVH") + " backend");
+}
+
+void SkinnedCollisionMesh::readInfluences(const v1::VertexData* vertexData, const v1::Mesh::IndexMap& indexMap)
+{
+	const auto indexElement = vertexData->vertexDeclaration->findElementBySemantic(VES_BLEND_INDICES);
+	const auto weightElement = vertexData->vertexDeclaration->findElementBySemantic(VES_BLEND_WEIGHTS);
+	assert(indexElement && weightElement);
+
+	//Both elements are often in the same buffer, which can only be locked once
+	const auto indexBuffer = vertexData->vertexBufferBinding->getBuffer(indexElement->getSource());
+	const auto weightBuffer = vertexData->vertexBufferBinding->getBuffer(weightElement->getSource());
+	const auto indexData = static_cast<const unsigned char*>(indexBuffer->lock(v1::HardwareBuffer::HBL_READ_ONLY));
+	const auto weightData = weightBuffer == indexBuffer ? indexData
+		: static_cast<const unsigned char*>(weightBuffer->lock(v1::HardwareBuffer::HBL_READ_ONLY));
+
+	const auto weightType = weightElement->getType();
+	const auto weightCount = std::min<size_t>(v1::VertexElement::getTypeCount(weightType), 4);
+	const auto previousSize = mInfluences.size();
+	mInfluences.resize(previousSize + vertexData->vertexCount);
+
+	for (auto v = size_t{ 0 }; v < vertexData->vertexCount; ++v)
+	{
+		const auto indices = indexData + v * indexBuffer->getVertexSize() + indexElement->getOffset();
+		float weights[4];
+		if (!readWeights(weightData + v * weightBuffer->getVertexSize() + weightElement->getOffset(), weightType, weightCount, weights))
+		{
+			//The type is the same for every vertex, this is the first one. Resized influences have no weight: the vertices stay in the binding pose
+			log("SkinnedCollisionMesh : blend weights of type " + std::to_string(weightType) + " aren't supported, "
+				+ std::to_string(vertexData->vertexCount) + " vertices won't be skinned");
+			break;
+		}
+
+		auto& influences = mInfluences[previousSize + v];
+		for (auto k = size_t{ 0 }; k < 4; ++k)
+		{
+			influences.bones[k] = k < weightCount ? (indexMap.empty() ? indices[k] : indexMap[indices[k]]) : 0;
+			influences.weights[k] = k < weightCount ? weights[k] : 0;
+		}
+	}
+
+	if (weightBuffer != indexBuffer)
+		weightBuffer->unlock();
+	indexBuffer->unlock();
+}
+
+void SkinnedCollisionMesh::readBoneMatrices()
+{
+	const auto skeleton = mEntity->getSkeleton();
+	if (const auto states = mEntity->getAllAnimationStates())
+		skeleton->setAnimationState(*states);
+	skeleton->_getBoneMatrices(mBoneMatrices.data());
+}
+
+void SkinnedCollisionMesh::setQuantizationBounds(const Vector3& minimum, const Vector3& maximum)
+{
+	//Flat meshes still need some room on every axis
+	auto margin = mBoundsMargin * (maximum - minimum);
+	margin.makeCeil(Vector3(1e-3f));
+	mQuantizationMinimum = minimum - margin;
+	mQuantizationMaximum = maximum + margin;
+}
+
+size_t SkinnedCollisionMesh::skin(Vector3& minimum, Vector3& maximum, Vector3& movedMinimum, Vector3& movedMaximum)
+{
+	struct ChunkBounds
+	{
+		Vector3 minimum, maximum;
+		Vector3 movedMinimum, movedMaximum;
+		size_t moved;
+	};
+
+	const auto chunkCount = (mVertices.size() + skinChunkSize - 1) / skinChunkSize;
+	std::vector<ChunkBounds> chunks(chunkCount);
+	const auto threshold = mRefitThreshold * mRefitThreshold;
+
+	const auto skinChunk = [&](size_t c)
+	{
+		auto& chunk = chunks[c];
+		makeEmptyBounds(chunk.minimum, chunk.maximum);
+		makeEmptyBounds(chunk.movedMinimum, chunk.movedMaximum);
+		chunk.moved = 0;
+
+		const auto end = std::min(mVertices.size(), (c + 1) * skinChunkSize);
+		for (auto v = c * skinChunkSize; v < end; ++v)
+		{
+			const auto& influences = mInfluences[v];
+			const auto& bindingPosition = mBindingPose[v];
+
+			auto position = Vector3::ZERO;
+			auto totalWeight = 0.0f;
+			for (auto k = 0; k < 4; ++k)
+			{
+				const auto weight = influences.weights[k];
+				if (weight <= 0) continue;
+				position += weight * mBoneMatrices[influences.bones[k]].transformAffine(bindingPosition);
+				totalWeight += weight;
+			}
+			position = totalWeight > 0 ? position / totalWeight : bindingPosition;
+
+			//The old and new positions are both in the part of the tree to refit
+			auto& vertex = mVertices[v];
+			if (vertex.squaredDistance(position) > threshold)
+			{
+				chunk.movedMinimum.makeFloor(vertex);
+				chunk.movedMaximum.makeCeil(vertex);
+				chunk.movedMinimum.makeFloor(position);
+				chunk.movedMaximum.makeCeil(position);
+				vertex = position;
+				++chunk.moved;
+			}
+
+			chunk.minimum.makeFloor(vertex);
+			chunk.maximum.makeCeil(vertex);
+		}
+	};
+
+	if (mPool)
+		mPool->parallelFor(chunkCount, skinChunk);
+	else
+		for (auto c = size_t{ 0 }; c < chunkCount; ++c) skinChunk(c);
+
+	makeEmptyBounds(minimum, maximum);
+	makeEmptyBounds(movedMinimum, movedMaximum);
+	auto moved = size_t{ 0 };
+	for (const auto& chunk : chunks)
+	{
+		minimum.makeFloor(chunk.minimum);
+		maximum.makeCeil(chunk.maximum);
+		movedMinimum.makeFloor(chunk.movedMinimum);
+		movedMaximum.makeCeil(chunk.movedMaximum);
+		moved += chunk.moved;
+	}
+	return moved;
+}
+
+void SkinnedCollisionMesh::update()
+{
+	auto start = Clock::now();
+	readBoneMatrices();
+
+	Vector3 minimum, maximum, movedMinimum, movedMaximum;
+	mLastUpdate.movedVertices = skin(minimum, maximum, movedMinimum, movedMaximum);
+	mLastUpdate.fullRefit = false;
+	mLastUpdate.skin = millisecondsSince(start);
+
+	start = Clock::now();
+	if (mLastUpdate.movedVertices)
+	{
+		if (mBackend == SkinnedBackend::GImpact)
+		{
+			//Marks the box trees of the parts dirty, updateBound() refits them
+			const auto shape = static_cast<btGImpactMeshShape*>(mShape.get());
+			shape->postUpdate();
+			shape->updateBound();
+		}
+		else
+		{
+			const auto shape = static_cast<btBvhTriangleMeshShape*>(mShape.get());
+			if (minimum > mQuantizationMinimum && maximum < mQuantizationMaximum)
+			{
+				//Only the subtrees overlapping what moved are refit
+				shape->partialRefitTree(Convert::toBullet(movedMinimum), Convert::toBullet(movedMaximum));
+			}
+			else
+			{
+				//The quantized nodes can't go out of the bounds the tree was built with, quantize again around the new pose
+				setQuantizationBounds(minimum, maximum);
+				shape->refitTree(Convert::toBullet(mQuantizationMinimum), Convert::toBullet(mQuantizationMaximum));
+				mLastUpdate.fullRefit = true;
+			}
+		}
+	}
+	mLastUpdate.refit = millisecondsSince(start);
+}
+
+void SkinnedCollisionMesh::setRefitThreshold(Real distance)
+{
+	mRefitThreshold = distance;
+}
@@ -0,0 +1,149 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreThreadPool.cpp
+ *
+ *    Description:  BtOgre worker pool implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+using namespace BtOgre;
+
+ThreadPool::ThreadPool(size_t threadCount) :
+	mStopping(false)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1U, std::thread::hardware_concurrency());
+
+	mWorkers.reserve(threadCount);
+	for (auto i = size_t{ 0 }; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::getSingleton()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+size_t ThreadPool::getThreadCount() const
+{
+	return mWorkers.size();
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mCondition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+
+			if (mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0) return;
+
+	if (count == 1 || mWorkers.empty())
+	{
+		for (auto i = size_t{ 0 }; i < count; ++i)
+			body(i);
+		return;
+	}
+
+	//Shared with the helper tasks, some of them may only start after we returned
+	struct State
+	{
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		size_t count;
+		std::function<void(size_t)> body;
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+
+	auto state = std::make_shared<State>();
+	state->next = 0;
+	state->done = 0;
+	state->count = count;
+	state->body = body;
+
+	const auto work = [state]
+	{
+		size_t i;
+		while ((i = state->next++) < state->count)
+		{
+			try
+			{
+				state->body(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (!state->error) state->error = std::current_exception();
+			}
+
+			if (++state->done == state->count)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	//The calling thread works too, so we never wait on helpers that didn't start. That makes nested calls safe
+	const auto helpers = std::min(count - 1, mWorkers.size());
+	for (auto i = size_t{ 0 }; i < helpers; ++i)
+		push(work);
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&] { return state->done == state->count; });
+
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
@@ -0,0 +1,236 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreTiledTrimesh.cpp
+ *
+ *    Description:  BtOgre tiled triangle mesh compound implementation.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreTiledTrimesh.h"
+#include "BtOgreGP.h"
+#include "BtOgreExtras.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Get the cell one level up that contains this one. The key must have a depth above 0
+	TileKey getParent(const TileKey& key)
+	{
+		//Rounds toward minus infinity, the cells of negative coordinates too
+		const auto half = [](int value) { return value >= 0 ? value / 2 : -((1 - value) / 2); };
+		return { half(key.x), half(key.y), half(key.z), key.depth - 1 };
+	}
+}
+
+bool TileKey::operator==(const TileKey& other) const
+{
+	return x == other.x && y == other.y && z == other.z && depth == other.depth;
+}
+
+bool TileKey::operator<(const TileKey& other) const
+{
+	return std::tie(depth, x, y, z) < std::tie(other.depth, other.x, other.y, other.z);
+}
+
+size_t TileKeyHash::operator()(const TileKey& key) const
+{
+	return (size_t(uint32_t(key.x)) * 73856093u) ^ (size_t(uint32_t(key.y)) * 19349663u)
+		^ (size_t(uint32_t(key.z)) * 83492791u) ^ (size_t(key.depth) * 2654435761u);
+}
+
+TiledTrimeshShape::TiledTrimeshShape(const TilingSettings& settings, const Vector3& scale) :
+	btCompoundShape(true),
+	mSettings(settings),
+	mScale(scale)
+{
+}
+
+TiledTrimeshShape::~TiledTrimeshShape()
+{
+	for (auto i = 0; i < getNumChildShapes(); ++i)
+		delete getChildShape(i);
+}
+
+TileKey TiledTrimeshShape::getTileKey(const Vector3& point, unsigned depth) const
+{
+	const auto size = mSettings.tileSize / Real(1u << depth);
+	return { int(std::floor(point.x / size.x)), int(std::floor(point.y / size.y)), int(std::floor(point.z / size.z)), depth };
+}
+
+Vector3 TiledTrimeshShape::getTileCenter(const TileKey& key) const
+{
+	const auto size = mSettings.tileSize / Real(1u << key.depth);
+	return (Vector3(Real(key.x), Real(key.y), Real(key.z)) + 0.5f) * size;
+}
+
+void TiledTrimeshShape::build(const Vector3* vertices, size_t, const unsigned* indices, size_t indexCount, ThreadPool* pool)
+{
+	const auto triangleCount = indexCount / 3;
+	std::vector<Vector3> centroids(triangleCount);
+	for (auto t = size_t{ 0 }; t < triangleCount; ++t)
+		centroids[t] = (vertices[indices[3 * t]] + vertices[indices[3 * t + 1]] + vertices[indices[3 * t + 2]]) / 3;
+
+	//Put the triangles in the grid cells
+	std::unordered_map<TileKey, std::vector<unsigned>, TileKeyHash> cells;
+	for (auto t = size_t{ 0 }; t < triangleCount; ++t)
+		cells[getTileKey(centroids[t])].push_back(unsigned(t));
+
+	//Split the crowded cells in 8 until they're small enough
+	std::vector<std::pair<TileKey, std::vector<unsigned>>> pending(cells.begin(), cells.end());
+	std::vector<std::pair<TileKey, std::vector<unsigned>>> tiles;
+	while (!pending.empty())
+	{
+		auto tile = std::move(pending.back());
+		pending.pop_back();
+
+		if (!mSettings.maxTileTriangles || tile.second.size() <= mSettings.maxTileTriangles || tile.first.depth >= mSettings.maxDepth)
+		{
+			tiles.push_back(std::move(tile));
+			continue;
+		}
+
+		std::unordered_map<TileKey, std::vector<unsigned>, TileKeyHash> children;
+		for (const auto t : tile.second)
+			children[getTileKey(centroids[t], tile.first.depth + 1)].push_back(t);
+		for (auto& child : children)
+			pending.emplace_back(child.first, std::move(child.second));
+	}
+
+	//Same children order whatever the hash tables did
+	std::sort(tiles.begin(), tiles.end(), [](const std::pair<TileKey, std::vector<unsigned>>& a, const std::pair<TileKey, std::vector<unsigned>>& b)
+	{
+		return a.first < b.first;
+	});
+
+	std::vector<btBvhTriangleMeshShape*> shapes(tiles.size());
+	const auto buildTile = [&](size_t i)
+	{
+		shapes[i] = createTile(tiles[i].first, vertices, indices, tiles[i].second);
+	};
+
+	if (pool)
+		pool->parallelFor(tiles.size(), buildTile);
+	else
+		for (auto i = size_t{ 0 }; i < tiles.size(); ++i)
+			buildTile(i);
+
+	//A rebuild can split the space differently: remove the existing tiles overlapping the new ones, at any depth.
+	//They overlap when one contains the other, so when one is the other or one of its ancestors
+	std::unordered_set<TileKey, TileKeyHash> rebuilt, rebuiltAncestors;
+	for (const auto& tile : tiles)
+	{
+		rebuilt.insert(tile.first);
+		for (auto key = tile.first; key.depth > 0;)
+		{
+			key = getParent(key);
+			if (!rebuiltAncestors.insert(key).second) break;
+		}
+	}
+
+	std::vector<TileKey> overlapped;
+	for (const auto& existing : mChildKeys)
+	{
+		auto overlaps = rebuiltAncestors.count(existing) != 0;
+		for (auto key = existing; !overlaps; key = getParent(key))
+		{
+			overlaps = rebuilt.count(key) != 0;
+			if (key.depth == 0) break;
+		}
+		if (overlaps) overlapped.push_back(existing);
+	}
+	for (const auto& key : overlapped)
+		setTile(key, nullptr);
+
+	for (auto i = size_t{ 0 }; i < tiles.size(); ++i)
+		setTile(tiles[i].first, shapes[i]);
+}
+
+btBvhTriangleMeshShape* TiledTrimeshShape::createTile(const TileKey& key, const Vector3* vertices, const unsigned* indices, size_t indexCount) const
+{
+	std::vector<unsigned> triangles(indexCount / 3);
+	std::iota(triangles.begin(), triangles.end(), 0u);
+	return createTile(key, vertices, indices, triangles);
+}
+
+btBvhTriangleMeshShape* TiledTrimeshShape::createTile(const TileKey& key, const Vector3* vertices, const unsigned* indices,
+	const std::vector<unsigned>& triangles) const
+{
+	//Keep only the vertices of the tile, relative to its center so the BVH quantization stays fine far from the origin
+	const auto center = getTileCenter(key);
+	std::unordered_map<unsigned, unsigned> remap;
+	VertexBuffer tileVertices;
+	IndexBuffer tileIndices;
+	tileIndices.reserve(3 * triangles.size());
+
+	for (const auto t : triangles)
+	{
+		for (auto i = 0; i < 3; ++i)
+		{
+			const auto vertex = indices[3 * size_t(t) + i];
+			const auto inserted = remap.emplace(vertex, unsigned(tileVertices.size()));
+			if (inserted.second)
+				tileVertices.push_back(vertices[vertex] - center);
+			tileIndices.push_back(inserted.first->second);
+		}
+	}
+
+	return new OwningBvhTriangleMeshShape(std::move(tileVertices), std::move(tileIndices), Convert::toBullet(mScale));
+}
+
+void TiledTrimeshShape::setTile(const TileKey& key, btCollisionShape* shape)
+{
+	const auto found = mTiles.find(key);
+	if (found != mTiles.end())
+	{
+		const auto index = found->second;
+		const auto old = getChildShape(index);
+		mTiles.erase(found);
+
+		//The compound moves its last child in the hole
+		removeChildShapeByIndex(index);
+		delete old;
+
+		const auto last = int(mChildKeys.size()) - 1;
+		if (index != last)
+		{
+			mChildKeys[size_t(index)] = mChildKeys[size_t(last)];
+			mTiles[mChildKeys[size_t(index)]] = index;
+		}
+		mChildKeys.pop_back();
+
+		//Removing a child doesn't shrink the compound's box, adding the new tile grows it again
+		recalculateLocalAabb();
+	}
+
+	if (!shape) return;
+
+	btTransform transform;
+	transform.setIdentity();
+	transform.setOrigin(Convert::toBullet(getTileCenter(key) * mScale));
+
+	addChildShape(transform, shape);
+	mTiles[key] = getNumChildShapes() - 1;
+	mChildKeys.push_back(key);
+}
+
+btCollisionShape* TiledTrimeshShape::getTile(const TileKey& key) const
+{
+	const auto found = mTiles.find(key);
+	return found != mTiles.end() ? const_cast<TiledTrimeshShape*>(this)->getChildShape(found->second) : nullptr;
+}
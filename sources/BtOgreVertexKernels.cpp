@@ -0,0 +1,572 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreVertexKernels.cpp
+ *
+ *    Description:  BtOgre position decoding kernels. Scalar, SSE2/F16C, AVX2/F16C and NEON.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreVertexKernels.h"
+
+#include <atomic>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <OgreBitwise.h>
+
+#if !OGRE_DOUBLE_PRECISION && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define BTOGRE_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif !OGRE_DOUBLE_PRECISION && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+#define BTOGRE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+//GCC and Clang need to be told which functions may use instructions above the compiler's baseline
+#if defined(__GNUC__) || defined(__clang__)
+#define BTOGRE_TARGET(x) __attribute__((target(x)))
+#else
+#define BTOGRE_TARGET(x)
+#endif
+
+using namespace Ogre;
+using namespace BtOgre;
+using namespace BtOgre::VertexKernels;
+
+namespace
+{
+	///Signature of a kernel. identity means the transform doesn't need to be applied. minimum and maximum are grown to contain the output
+	using Kernel = void(*)(const unsigned char*, size_t, size_t, const Matrix4&, bool, Vector3*, Vector3&, Vector3&);
+
+	///Affine transforms can be vectorized without changing the result, projective ones need the divide by w
+	bool isAffine(const Matrix4& transform)
+	{
+		return transform[3][0] == 0 && transform[3][1] == 0 && transform[3][2] == 0 && transform[3][3] == 1;
+	}
+
+	///Read a VET_FLOAT3 position
+	struct Float3Loader
+	{
+		static Vector3 load(const unsigned char* data)
+		{
+			float position[3];
+			std::memcpy(position, data, sizeof position);
+			return { position[0], position[1], position[2] };
+		}
+	};
+
+	///Read a VET_HALF4 position, ignoring w
+	struct Half4Loader
+	{
+		static Vector3 load(const unsigned char* data)
+		{
+			uint16 position[3];
+			std::memcpy(position, data, sizeof position);
+			return { Bitwise::halfToFloat(position[0]), Bitwise::halfToFloat(position[1]), Bitwise::halfToFloat(position[2]) };
+		}
+	};
+
+	///Reference implementation, also used for the vertices left after the vectorized blocks
+	template<typename Loader>
+	void scalarKernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto position = Loader::load(source + i * stride);
+			const auto vertex = identity ? position : transform * position;
+			destination[i] = vertex;
+
+			minimum.x = std::min(minimum.x, vertex.x);
+			minimum.y = std::min(minimum.y, vertex.y);
+			minimum.z = std::min(minimum.z, vertex.z);
+			maximum.x = std::max(maximum.x, vertex.x);
+			maximum.y = std::max(maximum.y, vertex.y);
+			maximum.z = std::max(maximum.z, vertex.z);
+		}
+	}
+
+#if BTOGRE_SIMD_X86
+
+	///CPU features we care about
+	struct CpuFeatures
+	{
+		bool avx2;
+		bool f16c;
+	};
+
+	void cpuid(unsigned leaf, unsigned subLeaf, unsigned registers[4])
+	{
+#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, int(leaf), int(subLeaf));
+		for (auto i = 0; i < 4; ++i) registers[i] = unsigned(values[i]);
+#else
+		__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	CpuFeatures detectCpuFeatures()
+	{
+		CpuFeatures features{ false, false };
+
+		unsigned registers[4];
+		cpuid(0, 0, registers);
+		const auto maxLeaf = registers[0];
+
+		cpuid(1, 0, registers);
+		const auto osxsave = (registers[2] & (1U << 27)) != 0;
+		const auto avx = (registers[2] & (1U << 28)) != 0;
+		const auto f16c = (registers[2] & (1U << 29)) != 0;
+		if (!osxsave || !avx) return features;
+
+		//The OS must save the YMM registers, F16C and AVX2 are VEX encoded
+#if defined(_MSC_VER)
+		const auto xcr0 = _xgetbv(0);
+#else
+		unsigned eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		const auto xcr0 = (uint64_t(edx) << 32) | eax;
+#endif
+		if ((xcr0 & 0x6) != 0x6) return features;
+
+		features.f16c = f16c;
+		if (maxLeaf >= 7)
+		{
+			cpuid(7, 0, registers);
+			features.avx2 = (registers[1] & (1U << 5)) != 0;
+		}
+		return features;
+	}
+
+	const CpuFeatures& getCpuFeatures()
+	{
+		static const auto features = detectCpuFeatures();
+		return features;
+	}
+
+	///Rows of the transform, broadcasted
+	struct SseAffine
+	{
+		explicit SseAffine(const Matrix4& transform)
+		{
+			for (auto row = 0; row < 3; ++row)
+				for (auto column = 0; column < 4; ++column)
+					m[row][column] = _mm_set1_ps(transform[row][column]);
+		}
+
+		__m128 m[3][4];
+	};
+
+	///Load x, y, z of a float position without reading past it
+	inline __m128 loadFloat3Row(const unsigned char* data)
+	{
+		const auto xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(data));
+		const auto z = _mm_load_ss(reinterpret_cast<const float*>(data + 2 * sizeof(float)));
+		return _mm_movelh_ps(xy, z);
+	}
+
+	///Same operations in the same order as Matrix4 * Vector3 for an affine matrix
+	inline __m128 transformRow(const __m128* row, __m128 x, __m128 y, __m128 z)
+	{
+		auto result = _mm_mul_ps(row[0], x);
+		result = _mm_add_ps(result, _mm_mul_ps(row[1], y));
+		result = _mm_add_ps(result, _mm_mul_ps(row[2], z));
+		return _mm_add_ps(result, row[3]);
+	}
+
+	///Write 4 positions given as rows. Each write spills one float into the next vertex, that gets overwritten next
+	inline void storeRows(Vector3* destination, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+	{
+		auto out = reinterpret_cast<float*>(destination);
+		_mm_storeu_ps(out, r0);
+		_mm_storeu_ps(out + 3, r1);
+		_mm_storeu_ps(out + 6, r2);
+		_mm_storel_pi(reinterpret_cast<__m64*>(out + 9), r3);
+		_mm_store_ss(out + 11, _mm_movehl_ps(r3, r3));
+	}
+
+	///Grow the bounds with 4 positions given as rows. The 4th lane is meaningless
+	inline void growBounds(__m128& minimum, __m128& maximum, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+	{
+		minimum = _mm_min_ps(minimum, _mm_min_ps(_mm_min_ps(r0, r1), _mm_min_ps(r2, r3)));
+		maximum = _mm_max_ps(maximum, _mm_max_ps(_mm_max_ps(r0, r1), _mm_max_ps(r2, r3)));
+	}
+
+	///Merge bounds kept as rows into the output ones
+	inline void mergeBounds(__m128 rowMinimum, __m128 rowMaximum, Vector3& minimum, Vector3& maximum)
+	{
+		float lanes[2][4];
+		_mm_storeu_ps(lanes[0], rowMinimum);
+		_mm_storeu_ps(lanes[1], rowMaximum);
+		minimum.makeFloor({ lanes[0][0], lanes[0][1], lanes[0][2] });
+		maximum.makeCeil({ lanes[1][0], lanes[1][1], lanes[1][2] });
+	}
+
+	///Transform 4 positions given as rows, and write them
+	inline void transformAndStore4(const SseAffine& affine, bool identity, __m128 r0, __m128 r1, __m128 r2, __m128 r3, Vector3* destination,
+		__m128& minimum, __m128& maximum)
+	{
+		if (!identity)
+		{
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			const auto x = transformRow(affine.m[0], r0, r1, r2);
+			const auto y = transformRow(affine.m[1], r0, r1, r2);
+			const auto z = transformRow(affine.m[2], r0, r1, r2);
+			r0 = x;
+			r1 = y;
+			r2 = z;
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		}
+		growBounds(minimum, maximum, r0, r1, r2, r3);
+		storeRows(destination, r0, r1, r2, r3);
+	}
+
+	BTOGRE_TARGET("sse2")
+	void sse2Float3Kernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		const SseAffine affine(transform);
+		auto rowMinimum = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		auto rowMaximum = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+		const auto blocks = count / 4 * 4;
+		for (size_t i = 0; i < blocks; i += 4)
+		{
+			const auto data = source + i * stride;
+			transformAndStore4(affine, identity,
+				loadFloat3Row(data), loadFloat3Row(data + stride), loadFloat3Row(data + 2 * stride), loadFloat3Row(data + 3 * stride),
+				destination + i, rowMinimum, rowMaximum);
+		}
+		mergeBounds(rowMinimum, rowMaximum, minimum, maximum);
+		scalarKernel<Float3Loader>(source + blocks * stride, stride, count - blocks, transform, identity, destination + blocks, minimum, maximum);
+	}
+
+	BTOGRE_TARGET("sse2,f16c")
+	inline __m128 loadHalf4Row(const unsigned char* data)
+	{
+		return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+	}
+
+	BTOGRE_TARGET("sse2,f16c")
+	void f16cHalf4Kernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		const SseAffine affine(transform);
+		auto rowMinimum = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		auto rowMaximum = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+		const auto blocks = count / 4 * 4;
+		for (size_t i = 0; i < blocks; i += 4)
+		{
+			const auto data = source + i * stride;
+			transformAndStore4(affine, identity,
+				loadHalf4Row(data), loadHalf4Row(data + stride), loadHalf4Row(data + 2 * stride), loadHalf4Row(data + 3 * stride),
+				destination + i, rowMinimum, rowMaximum);
+		}
+		mergeBounds(rowMinimum, rowMaximum, minimum, maximum);
+		scalarKernel<Half4Loader>(source + blocks * stride, stride, count - blocks, transform, identity, destination + blocks, minimum, maximum);
+	}
+
+	///Transform 8 positions given as two groups of 4 rows with 256 bits operations, and write them
+	BTOGRE_TARGET("avx2")
+	inline void transformAndStore8(const __m256* row, __m128 a0, __m128 a1, __m128 a2, __m128 a3,
+		__m128 b0, __m128 b1, __m128 b2, __m128 b3, Vector3* destination, __m128& minimum, __m128& maximum)
+	{
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		const auto x = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), b0, 1);
+		const auto y = _mm256_insertf128_ps(_mm256_castps128_ps256(a1), b1, 1);
+		const auto z = _mm256_insertf128_ps(_mm256_castps128_ps256(a2), b2, 1);
+
+		__m256 result[3];
+		for (auto r = 0; r < 3; ++r)
+		{
+			const auto m = row + 4 * r;
+			result[r] = _mm256_mul_ps(m[0], x);
+			result[r] = _mm256_add_ps(result[r], _mm256_mul_ps(m[1], y));
+			result[r] = _mm256_add_ps(result[r], _mm256_mul_ps(m[2], z));
+			result[r] = _mm256_add_ps(result[r], m[3]);
+		}
+
+		a0 = _mm256_castps256_ps128(result[0]);
+		a1 = _mm256_castps256_ps128(result[1]);
+		a2 = _mm256_castps256_ps128(result[2]);
+		b0 = _mm256_extractf128_ps(result[0], 1);
+		b1 = _mm256_extractf128_ps(result[1], 1);
+		b2 = _mm256_extractf128_ps(result[2], 1);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		growBounds(minimum, maximum, a0, a1, a2, a3);
+		growBounds(minimum, maximum, b0, b1, b2, b3);
+		storeRows(destination, a0, a1, a2, a3);
+		storeRows(destination + 4, b0, b1, b2, b3);
+	}
+
+	///Rows of the transform broadcasted to 256 bits registers
+	BTOGRE_TARGET("avx2")
+	inline void broadcastAffine(const Matrix4& transform, __m256* row)
+	{
+		for (auto r = 0; r < 3; ++r)
+			for (auto c = 0; c < 4; ++c)
+				row[4 * r + c] = _mm256_set1_ps(transform[r][c]);
+	}
+
+	BTOGRE_TARGET("avx2")
+	void avx2Float3Kernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		//Without transform there's no math to widen, the 4 wide kernel only moves data around
+		if (identity) return sse2Float3Kernel(source, stride, count, transform, identity, destination, minimum, maximum);
+
+		__m256 row[12];
+		broadcastAffine(transform, row);
+
+		auto rowMinimum = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		auto rowMaximum = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+		const auto blocks = count / 8 * 8;
+		for (size_t i = 0; i < blocks; i += 8)
+		{
+			const auto data = source + i * stride;
+			transformAndStore8(row,
+				loadFloat3Row(data), loadFloat3Row(data + stride), loadFloat3Row(data + 2 * stride), loadFloat3Row(data + 3 * stride),
+				loadFloat3Row(data + 4 * stride), loadFloat3Row(data + 5 * stride), loadFloat3Row(data + 6 * stride), loadFloat3Row(data + 7 * stride),
+				destination + i, rowMinimum, rowMaximum);
+		}
+		mergeBounds(rowMinimum, rowMaximum, minimum, maximum);
+		sse2Float3Kernel(source + blocks * stride, stride, count - blocks, transform, identity, destination + blocks, minimum, maximum);
+	}
+
+	BTOGRE_TARGET("avx2,f16c")
+	void avx2Half4Kernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		if (identity) return f16cHalf4Kernel(source, stride, count, transform, identity, destination, minimum, maximum);
+
+		__m256 row[12];
+		broadcastAffine(transform, row);
+
+		auto rowMinimum = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		auto rowMaximum = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+		const auto blocks = count / 8 * 8;
+		for (size_t i = 0; i < blocks; i += 8)
+		{
+			const auto data = source + i * stride;
+			transformAndStore8(row,
+				loadHalf4Row(data), loadHalf4Row(data + stride), loadHalf4Row(data + 2 * stride), loadHalf4Row(data + 3 * stride),
+				loadHalf4Row(data + 4 * stride), loadHalf4Row(data + 5 * stride), loadHalf4Row(data + 6 * stride), loadHalf4Row(data + 7 * stride),
+				destination + i, rowMinimum, rowMaximum);
+		}
+		mergeBounds(rowMinimum, rowMaximum, minimum, maximum);
+		f16cHalf4Kernel(source + blocks * stride, stride, count - blocks, transform, identity, destination + blocks, minimum, maximum);
+	}
+
+#elif BTOGRE_SIMD_NEON
+
+	///Load x, y, z of a float position without reading past it
+	inline float32x4_t loadFloat3Row(const unsigned char* data)
+	{
+		const auto position = reinterpret_cast<const float*>(data);
+		return vcombine_f32(vld1_f32(position), vld1_lane_f32(position + 2, vdup_n_f32(0), 0));
+	}
+
+	///Load a half position and convert it
+	inline float32x4_t loadHalf4Row(const unsigned char* data)
+	{
+		return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(data))));
+	}
+
+	///Same operations in the same order as Matrix4 * Vector3 for an affine matrix. No vmla/vfma, they would change the rounding
+	inline float32x4_t transformRow(const float32x4_t* row, float32x4_t x, float32x4_t y, float32x4_t z)
+	{
+		auto result = vmulq_f32(row[0], x);
+		result = vaddq_f32(result, vmulq_f32(row[1], y));
+		result = vaddq_f32(result, vmulq_f32(row[2], z));
+		return vaddq_f32(result, row[3]);
+	}
+
+	template<float32x4_t(*LoadRow)(const unsigned char*), typename Loader>
+	void neonKernel(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, bool identity, Vector3* destination,
+		Vector3& minimum, Vector3& maximum)
+	{
+		float32x4_t row[3][4];
+		for (auto r = 0; r < 3; ++r)
+			for (auto c = 0; c < 4; ++c)
+				row[r][c] = vdupq_n_f32(transform[r][c]);
+
+		float32x4_t lowest[3], highest[3];
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			lowest[axis] = vdupq_n_f32(std::numeric_limits<float>::infinity());
+			highest[axis] = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+		}
+
+		const auto blocks = count / 4 * 4;
+		for (size_t i = 0; i < blocks; i += 4)
+		{
+			const auto data = source + i * stride;
+			const auto t01 = vtrnq_f32(LoadRow(data), LoadRow(data + stride));
+			const auto t23 = vtrnq_f32(LoadRow(data + 2 * stride), LoadRow(data + 3 * stride));
+
+			float32x4x3_t position;
+			position.val[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+			position.val[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+			position.val[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+
+			if (!identity)
+			{
+				const auto x = position.val[0], y = position.val[1], z = position.val[2];
+				position.val[0] = transformRow(row[0], x, y, z);
+				position.val[1] = transformRow(row[1], x, y, z);
+				position.val[2] = transformRow(row[2], x, y, z);
+			}
+
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				lowest[axis] = vminq_f32(lowest[axis], position.val[axis]);
+				highest[axis] = vmaxq_f32(highest[axis], position.val[axis]);
+			}
+
+			//Interleave back to x, y, z: exactly 4 Vector3s
+			vst3q_f32(reinterpret_cast<float*>(destination + i), position);
+		}
+
+		float lanes[4];
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			vst1q_f32(lanes, lowest[axis]);
+			minimum[axis] = std::min(minimum[axis], std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])));
+			vst1q_f32(lanes, highest[axis]);
+			maximum[axis] = std::max(maximum[axis], std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+		}
+
+		scalarKernel<Loader>(source + blocks * stride, stride, count - blocks, transform, identity, destination + blocks, minimum, maximum);
+	}
+
+#endif
+
+	///Kernels used for each vertex format
+	struct KernelTable
+	{
+		InstructionSet instructionSet;
+		Kernel float3;
+		Kernel half4;
+	};
+
+	KernelTable makeKernelTable(InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+#if BTOGRE_SIMD_X86
+		case InstructionSet::AVX2:
+			return { InstructionSet::AVX2, avx2Float3Kernel, getCpuFeatures().f16c ? avx2Half4Kernel : scalarKernel<Half4Loader> };
+		case InstructionSet::SSE2:
+			return { InstructionSet::SSE2, sse2Float3Kernel, getCpuFeatures().f16c ? f16cHalf4Kernel : scalarKernel<Half4Loader> };
+#elif BTOGRE_SIMD_NEON
+		case InstructionSet::NEON:
+			return { InstructionSet::NEON, neonKernel<loadFloat3Row, Float3Loader>, neonKernel<loadHalf4Row, Half4Loader> };
+#endif
+		default:
+			return { InstructionSet::Scalar, scalarKernel<Float3Loader>, scalarKernel<Half4Loader> };
+		}
+	}
+
+	///Currently selected kernels. Stored as an index so switching is atomic
+	std::atomic<int> selectedInstructionSet{ -1 };
+
+	const KernelTable& getKernels()
+	{
+		static const KernelTable tables[]
+		{
+			makeKernelTable(InstructionSet::Scalar),
+			makeKernelTable(InstructionSet::SSE2),
+			makeKernelTable(InstructionSet::AVX2),
+			makeKernelTable(InstructionSet::NEON)
+		};
+
+		auto selected = selectedInstructionSet.load();
+		if (selected < 0)
+		{
+			selected = int(getSupportedInstructionSet());
+			selectedInstructionSet = selected;
+		}
+		return tables[selected];
+	}
+
+	///Run the selected kernel, or the scalar reference one when the transform is projective
+	void dispatch(Kernel KernelTable::* kernel, Kernel reference, const unsigned char* source, size_t stride, size_t count,
+		const Matrix4& transform, Vector3* destination, Vector3& minimum, Vector3& maximum)
+	{
+		if (count == 0) return;
+
+		const auto identity = transform == Matrix4::IDENTITY;
+		if (!identity && !isAffine(transform))
+			return reference(source, stride, count, transform, false, destination, minimum, maximum);
+
+		(getKernels().*kernel)(source, stride, count, transform, identity, destination, minimum, maximum);
+	}
+}
+
+InstructionSet VertexKernels::getSupportedInstructionSet()
+{
+#if BTOGRE_SIMD_X86
+	return getCpuFeatures().avx2 ? InstructionSet::AVX2 : InstructionSet::SSE2;
+#elif BTOGRE_SIMD_NEON
+	return InstructionSet::NEON;
+#else
+	return InstructionSet::Scalar;
+#endif
+}
+
+InstructionSet VertexKernels::getInstructionSet()
+{
+	return getKernels().instructionSet;
+}
+
+void VertexKernels::setInstructionSet(InstructionSet instructionSet)
+{
+	const auto supported = getSupportedInstructionSet();
+	auto usable = instructionSet == InstructionSet::Scalar || instructionSet == supported;
+#if BTOGRE_SIMD_X86
+	usable = usable || instructionSet == InstructionSet::SSE2;
+#endif
+	selectedInstructionSet = int(usable ? instructionSet : supported);
+}
+
+bool VertexKernels::hasHardwareHalfConversion()
+{
+#if BTOGRE_SIMD_X86
+	return getCpuFeatures().f16c && getInstructionSet() != InstructionSet::Scalar;
+#elif BTOGRE_SIMD_NEON
+	return getInstructionSet() == InstructionSet::NEON;
+#else
+	return false;
+#endif
+}
+
+void VertexKernels::transformFloat3(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, Vector3* destination,
+	Vector3& minimum, Vector3& maximum)
+{
+	dispatch(&KernelTable::float3, scalarKernel<Float3Loader>, source, stride, count, transform, destination, minimum, maximum);
+}
+
+void VertexKernels::transformHalf4(const unsigned char* source, size_t stride, size_t count, const Matrix4& transform, Vector3* destination,
+	Vector3& minimum, Vector3& maximum)
+{
+	dispatch(&KernelTable::half4, scalarKernel<Half4Loader>, source, stride, count, transform, destination, minimum, maximum);
+}
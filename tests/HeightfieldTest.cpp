@@ -0,0 +1,121 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  HeightfieldTest.cpp
+ *
+ *    Description:  Checks that Heightfield::detectGrid only accepts meshes that collide
+ *                  like the heightfield built from them.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BtOgreHeightfield.h"
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Cells of the test grid along x and z
+	const int cellCount = 4;
+
+	int failures = 0;
+
+	///Which diagonal a cell is split along, or how it's broken
+	enum class Split
+	{
+		Regular, ///<(x+1, z)-(x, z+1) diagonal
+		Flipped, ///<(x, z)-(x+1, z+1) diagonal
+		Hole,    ///<No triangle
+		Mixed    ///<One half of each diagonal
+	};
+
+	struct Mesh
+	{
+		std::vector<Vector3> vertices;
+		std::vector<unsigned> indices;
+	};
+
+	///(cellCount + 1)^2 samples on a bumpy surface, each cell split as asked
+	template<typename SplitOf>
+	Mesh makeGrid(SplitOf splitOf)
+	{
+		Mesh mesh;
+		for (auto z = 0; z <= cellCount; ++z)
+			for (auto x = 0; x <= cellCount; ++x)
+				mesh.vertices.push_back(Vector3(Real(x) * 2, Real((x * 7 + z * 3) % 5), Real(z) * 3));
+
+		const auto sample = [](int x, int z) { return unsigned(z * (cellCount + 1) + x); };
+		const auto addTriangle = [&](unsigned a, unsigned b, unsigned c)
+		{
+			mesh.indices.insert(mesh.indices.end(), { a, b, c });
+		};
+
+		for (auto z = 0; z < cellCount; ++z)
+		{
+			for (auto x = 0; x < cellCount; ++x)
+			{
+				const auto c0 = sample(x, z), c1 = sample(x + 1, z), c2 = sample(x, z + 1), c3 = sample(x + 1, z + 1);
+				switch (splitOf(x, z))
+				{
+				case Split::Regular: addTriangle(c0, c1, c2); addTriangle(c1, c3, c2); break;
+				case Split::Flipped: addTriangle(c0, c1, c3); addTriangle(c0, c3, c2); break;
+				case Split::Mixed: addTriangle(c0, c1, c2); addTriangle(c0, c1, c3); break;
+				case Split::Hole: break;
+				}
+			}
+		}
+		return mesh;
+	}
+
+	void check(const std::string& name, const Mesh& mesh, bool expectedGrid, bool expectedFlip = false)
+	{
+		HeightfieldGrid grid;
+		const auto isGrid = Heightfield::detectGrid(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), grid);
+		if (isGrid != expectedGrid)
+		{
+			std::cerr << "FAILED : " << name << (expectedGrid ? " : not detected as a grid" : " : detected as a grid") << std::endl;
+			++failures;
+			return;
+		}
+
+		if (isGrid && (grid.width != cellCount + 1 || grid.length != cellCount + 1 || grid.flipQuadEdges != expectedFlip))
+		{
+			std::cerr << "FAILED : " << name << " : wrong grid size or diagonal" << std::endl;
+			++failures;
+		}
+	}
+}
+
+int main()
+{
+	check("regular grid", makeGrid([](int, int) { return Split::Regular; }), true, false);
+	check("flipped grid", makeGrid([](int, int) { return Split::Flipped; }), true, true);
+
+	//Every sample is still there, only the triangles of one cell are missing
+	check("hole", makeGrid([](int x, int z) { return x == 1 && z == 2 ? Split::Hole : Split::Regular; }), false);
+	check("mixed diagonals", makeGrid([](int x, int) { return x % 2 ? Split::Flipped : Split::Regular; }), false);
+	check("two diagonals in a cell", makeGrid([](int x, int z) { return x == 3 && z == 0 ? Split::Mixed : Split::Flipped; }), false);
+
+	auto duplicated = makeGrid([](int, int) { return Split::Regular; });
+	duplicated.indices.insert(duplicated.indices.end(), duplicated.indices.begin(), duplicated.indices.begin() + 3);
+	check("duplicated triangle", duplicated, false);
+
+	if (failures)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "detectGrid accepts exactly the regular grids" << std::endl;
+	return EXIT_SUCCESS;
+}
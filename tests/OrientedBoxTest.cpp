@@ -0,0 +1,107 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  OrientedBoxTest.cpp
+ *
+ *    Description:  Checks that box shapes placed with their transform enclose the points
+ *                  they were fitted around, tightly.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BtOgreOrientedBox.h"
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	int failures = 0;
+
+	///Deterministic random numbers, the same on every platform
+	struct Random
+	{
+		uint32_t state;
+
+		Real next(Real minimum, Real maximum)
+		{
+			state = state * 1664525u + 1013904223u;
+			return minimum + (maximum - minimum) * Real(state >> 8) / Real(1u << 24);
+		}
+	};
+
+	///Every point must be in the placed shape, and the points must reach every face of it
+	void check(const std::string& name, const OrientedBox& box, const std::vector<Vector3>& points)
+	{
+		std::unique_ptr<btBoxShape> shape(box.createShape());
+		const auto transform = box.getTransform();
+		const auto halfExtents = shape->getHalfExtentsWithMargin();
+
+		//Relative to the size of the box, the fit is done in floats
+		const auto epsilon = btScalar(1e-4) * halfExtents.length();
+
+		btVector3 reach(0, 0, 0);
+		for (const auto& point : points)
+		{
+			const auto local = transform.invXform(btVector3(point.x, point.y, point.z));
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				if (std::abs(local[axis]) > halfExtents[axis] + epsilon)
+				{
+					std::cerr << "FAILED : " << name << " : a point is outside of the box" << std::endl;
+					++failures;
+					return;
+				}
+				reach[axis] = std::max(reach[axis], std::abs(local[axis]));
+			}
+		}
+
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			if (reach[axis] < halfExtents[axis] - epsilon)
+			{
+				std::cerr << "FAILED : " << name << " : the box is larger than the points along axis " << axis << std::endl;
+				++failures;
+				return;
+			}
+		}
+	}
+}
+
+int main()
+{
+	Random random{ 7 };
+
+	//Points filling a rotated, off center box, like the vertices of a forearm
+	const Quaternion orientation(Degree(40), Vector3(1, 2, -1).normalisedCopy());
+	const Vector3 center(3, -2, 10);
+	std::vector<Vector3> points(500);
+	for (auto& point : points)
+		point = center + orientation * Vector3(random.next(-4, 4), random.next(-1, 1), random.next(-0.5f, 0.5f));
+
+	check("box along given axes", OrientedBoxFitter::fitAxes(points.data(), points.size(), orientation), points);
+	check("box along other axes", OrientedBoxFitter::fitAxes(points.data(), points.size(), Quaternion(Degree(15), Vector3::UNIT_Y)), points);
+	check("fitted box", OrientedBoxFitter::fit(points.data(), points.size()), points);
+
+	if (failures)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Placed boxes enclose their points tightly" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  VertexKernelsTest.cpp
+ *
+ *    Description:  Checks every VertexKernels instruction set bit for bit against the
+ *                  scalar Matrix4 * Vector3 reference.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <OgreBitwise.h>
+#include <OgreQuaternion.h>
+
+#include "BtOgreVertexKernels.h"
+
+using namespace Ogre;
+using namespace BtOgre;
+using namespace BtOgre::VertexKernels;
+
+namespace
+{
+	///Vertex counts around the 4 and 8 wide blocks, to go through every tail length
+	const size_t counts[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 15, 16, 17, 31, 33, 100, 1031 };
+
+	int failures = 0;
+
+	///Deterministic random numbers, the same on every platform
+	struct Random
+	{
+		uint32_t state;
+
+		Real next(Real minimum, Real maximum)
+		{
+			state = state * 1664525u + 1013904223u;
+			return minimum + (maximum - minimum) * Real(state >> 8) / Real(1u << 24);
+		}
+	};
+
+	const char* getName(InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+		case InstructionSet::SSE2: return "SSE2";
+		case InstructionSet::AVX2: return "AVX2";
+		case InstructionSet::NEON: return "NEON";
+		default: return "Scalar";
+		}
+	}
+
+	void fail(const std::string& message)
+	{
+		std::cerr << "FAILED : " << message << std::endl;
+		++failures;
+	}
+
+	///What the kernels must give: the transform applied by Ogre, except for the identity that is skipped
+	Vector3 reference(const Matrix4& transform, const Vector3& position)
+	{
+		return transform == Matrix4::IDENTITY ? position : transform * position;
+	}
+
+	///Write the positions stride bytes apart, with garbage between them that the kernels must not read as data
+	std::vector<unsigned char> makeFloat3Buffer(const std::vector<Vector3>& positions, size_t stride)
+	{
+		std::vector<unsigned char> buffer(positions.size() * stride + 1, 0xCD);
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			const float position[3] = { positions[i].x, positions[i].y, positions[i].z };
+			std::memcpy(buffer.data() + i * stride, position, sizeof position);
+		}
+		return buffer;
+	}
+
+	std::vector<unsigned char> makeHalf4Buffer(const std::vector<Vector3>& positions, size_t stride)
+	{
+		std::vector<unsigned char> buffer(positions.size() * stride + 1, 0xCD);
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			const uint16 position[4] = { Bitwise::floatToHalf(positions[i].x), Bitwise::floatToHalf(positions[i].y),
+				Bitwise::floatToHalf(positions[i].z), Bitwise::floatToHalf(1) };
+			std::memcpy(buffer.data() + i * stride, position, sizeof position);
+		}
+		return buffer;
+	}
+
+	///Run a kernel and compare its output and bounds with the reference
+	template<typename Transform>
+	void check(const std::string& name, Transform kernel, const std::vector<unsigned char>& buffer, size_t stride,
+		const std::vector<Vector3>& decoded, const Matrix4& transform)
+	{
+		const auto count = decoded.size();
+
+		//One more vertex than needed, the kernels must not write past the end
+		const Vector3 canary(12345, -12345, 54321);
+		std::vector<Vector3> output(count + 1, canary);
+		auto minimum = Vector3(std::numeric_limits<Real>::infinity());
+		auto maximum = Vector3(-std::numeric_limits<Real>::infinity());
+		kernel(buffer.data(), stride, count, transform, output.data(), minimum, maximum);
+
+		auto expectedMinimum = Vector3(std::numeric_limits<Real>::infinity());
+		auto expectedMaximum = Vector3(-std::numeric_limits<Real>::infinity());
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto expected = reference(transform, decoded[i]);
+			expectedMinimum.makeFloor(expected);
+			expectedMaximum.makeCeil(expected);
+
+			if (std::memcmp(&output[i], &expected, sizeof(Vector3)) != 0)
+			{
+				fail(name + " : vertex " + std::to_string(i) + " of " + std::to_string(count) + " differs from the reference");
+				return;
+			}
+		}
+
+		if (std::memcmp(&output[count], &canary, sizeof(Vector3)) != 0)
+			fail(name + " : wrote past the last vertex");
+
+		if (minimum != expectedMinimum || maximum != expectedMaximum)
+			fail(name + " : bounds differ from the reference");
+	}
+
+	void checkInstructionSet(InstructionSet instructionSet, const std::vector<Matrix4>& transforms)
+	{
+		setInstructionSet(instructionSet);
+		if (getInstructionSet() != instructionSet)
+		{
+			std::cout << getName(instructionSet) << " : not supported, skipped" << std::endl;
+			return;
+		}
+		std::cout << getName(instructionSet) << (hasHardwareHalfConversion() ? " : hardware half conversion" : " : software half conversion") << std::endl;
+
+		Random random{ 42 };
+		for (auto t = size_t{ 0 }; t < transforms.size(); ++t)
+		{
+			for (const auto count : counts)
+			{
+				std::vector<Vector3> positions(count);
+				for (auto& position : positions)
+					position = Vector3(random.next(-1000, 1000), random.next(-1000, 1000), random.next(-1000, 1000));
+
+				const auto prefix = std::string(getName(instructionSet)) + " transform " + std::to_string(t) + " count " + std::to_string(count);
+
+				for (const size_t stride : { 12, 16, 20, 32, 44 })
+					check(prefix + " float3 stride " + std::to_string(stride), transformFloat3, makeFloat3Buffer(positions, stride), stride, positions, transforms[t]);
+
+				//The reference decodes halves with Ogre's software conversion
+				std::vector<Vector3> halves(count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					for (auto axis = 0; axis < 3; ++axis)
+						halves[i][axis] = Bitwise::halfToFloat(Bitwise::floatToHalf(positions[i][axis] / 16));
+				}
+				for (const size_t stride : { 8, 12, 16, 24 })
+					check(prefix + " half4 stride " + std::to_string(stride), transformHalf4, makeHalf4Buffer(halves, stride), stride, halves, transforms[t]);
+			}
+		}
+	}
+}
+
+int main()
+{
+	Matrix4 affine;
+	affine.makeTransform(Vector3(10.5f, -3.25f, 700), Vector3(1.5f, 0.75f, -2), Quaternion(Degree(33), Vector3(1, 2, 3).normalisedCopy()));
+
+	auto projective = affine;
+	projective[3][2] = 0.01f;
+
+	const std::vector<Matrix4> transforms = { Matrix4::IDENTITY, affine, projective };
+
+	for (const auto instructionSet : { InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::NEON })
+		checkInstructionSet(instructionSet, transforms);
+
+	if (failures)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Every kernel matches the reference" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  main.cpp
+ *
+ *    Description:  btogre_bake, offline collision baking tool. Converts a tree of .mesh
+ *                  files to .bullet files with Ogre's NULL render system.
+ *
+ *        Version:  1.0
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+//C++ standard library
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//Ogre includes
+#include <Ogre.h>
+#include <OgreArchive.h>
+#include <OgreArchiveManager.h>
+#include <OgreMesh.h>
+#include <OgreMeshManager.h>
+#if defined(OGRE_NEXT_VERSION) && OGRE_NEXT_VERSION >= 0x30000
+#include <OgreAbiUtils.h>
+#endif
+
+//Bullet includes
+#include <LinearMath/btSerializer.h>
+
+//BtOgre includes
+#include <BtOgre.hpp>
+
+using namespace Ogre;
+
+namespace
+{
+	///What to do, from the command line
+	struct Options
+	{
+		String input;
+		String output;
+		String pluginFolder;
+		BtOgre::ShapeKind kind = BtOgre::ShapeKind::Trimesh;
+		Real weldEpsilon = -1;
+		size_t simplifyTriangles = 0;
+		unsigned short lod = 0;
+		size_t threads = 0;
+		bool force = false;
+	};
+
+	///A mesh waiting for its shape to be written
+	struct PendingShape
+	{
+		String output;
+		std::future<std::vector<char>> data;
+	};
+
+	void printUsage()
+	{
+		std::cout << "Usage: btogre_bake <input folder> <output folder> [options]\n"
+			"Convert every .mesh file under the input folder to a .bullet file at the same place under the output folder.\n"
+			"Outputs newer than their mesh are skipped. Load them with btBulletWorldImporter.\n"
+			"Options:\n"
+			"  --shape <kind>       sphere, box, cylinder, capsule, convex, trimesh (default) or decomposition\n"
+			"  --weld <epsilon>     Merge the vertices closer than epsilon first\n"
+			"  --simplify <count>   Simplify the mesh to this many triangles first\n"
+			"  --lod <level>        Use this LOD level of the meshes\n"
+			"  --threads <count>    Number of worker threads, one per core by default\n"
+			"  --plugins <folder>   Folder of the RenderSystem_NULL plugin\n"
+			"  --force              Rebuild the outputs that are up to date\n";
+	}
+
+	bool parseShapeKind(const String& name, BtOgre::ShapeKind& kind)
+	{
+		const std::pair<const char*, BtOgre::ShapeKind> kinds[]
+		{
+			{ "sphere", BtOgre::ShapeKind::Sphere },
+			{ "box", BtOgre::ShapeKind::Box },
+			{ "cylinder", BtOgre::ShapeKind::Cylinder },
+			{ "capsule", BtOgre::ShapeKind::Capsule },
+			{ "convex", BtOgre::ShapeKind::Convex },
+			{ "trimesh", BtOgre::ShapeKind::Trimesh },
+			{ "decomposition", BtOgre::ShapeKind::ConvexDecomposition },
+		};
+
+		for (const auto& entry : kinds)
+		{
+			if (name == entry.first)
+			{
+				kind = entry.second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool parseOptions(int argc, char* argv[], Options& options)
+	{
+		if (argc < 3) return false;
+		options.input = argv[1];
+		options.output = argv[2];
+
+		for (auto i = 3; i < argc; ++i)
+		{
+			const String option = argv[i];
+			if (option == "--force")
+			{
+				options.force = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) return false;
+			const String value = argv[++i];
+
+			if (option == "--shape")
+			{
+				if (!parseShapeKind(value, options.kind)) return false;
+			}
+			else if (option == "--weld") options.weldEpsilon = Real(std::atof(value.c_str()));
+			else if (option == "--simplify") options.simplifyTriangles = size_t(std::atoll(value.c_str()));
+			else if (option == "--lod") options.lod = static_cast<unsigned short>(std::atoi(value.c_str()));
+			else if (option == "--threads") options.threads = size_t(std::atoi(value.c_str()));
+			else if (option == "--plugins") options.pluginFolder = value;
+			else return false;
+		}
+
+		return true;
+	}
+
+	///Create a folder if it doesn't exist
+	void createFolder(const String& folder)
+	{
+#ifdef _WIN32
+		_mkdir(folder.c_str());
+#else
+		mkdir(folder.c_str(), 0755);
+#endif
+	}
+
+	///Create the folders leading to a file under root. Ogre's archives don't
+	void createFolders(const String& root, const String& file)
+	{
+		for (auto slash = file.find('/'); slash != String::npos; slash = file.find('/', slash + 1))
+			createFolder(root + "/" + file.substr(0, slash));
+	}
+
+	///Start Ogre with the NULL render system: no window, no GPU. Mesh data stays in system memory
+	std::unique_ptr<Root> startOgre(const Options& options)
+	{
+#if defined(OGRE_NEXT_VERSION) && OGRE_NEXT_VERSION >= 0x30000
+		//Ogre-next 3 checks the application was built against the same headers as the library
+		const auto abiCookie = generateAbiCookie();
+		std::unique_ptr<Root> root(new Root(&abiCookie, "", "", "btogre_bake.log"));
+#else
+		std::unique_ptr<Root> root(new Root("", "", "btogre_bake.log"));
+#endif
+
+		auto plugin = String("RenderSystem_NULL");
+#if OGRE_DEBUG_MODE
+		plugin += "_d";
+#endif
+		if (!options.pluginFolder.empty())
+			plugin = options.pluginFolder + "/" + plugin;
+		root->loadPlugin(plugin);
+
+		root->setRenderSystem(root->getRenderSystemByName("NULL Rendering Subsystem"));
+		root->initialise(false);
+
+		//The buffer managers are created with the first window, the NULL one is never shown
+		root->createRenderWindow("btogre_bake", 1, 1, false);
+		return root;
+	}
+
+	///Fill a converter from the mesh. Ogre's resource system isn't thread safe, this runs on the main thread
+	std::unique_ptr<BtOgre::StaticMeshToShapeConverter> loadMesh(const String& name, const Options& options)
+	{
+		auto mesh = v1::MeshManager::getSingleton().load(name, "Bake",
+			v1::HardwareBuffer::HBU_STATIC, v1::HardwareBuffer::HBU_STATIC, true, true);
+
+		std::unique_ptr<BtOgre::StaticMeshToShapeConverter> converter(new BtOgre::StaticMeshToShapeConverter);
+		converter->addMesh(mesh.get(), Matrix4::IDENTITY, options.lod);
+
+		v1::MeshManager::getSingleton().remove(mesh->getHandle());
+
+		if (!converter->getTriangleCount())
+			throw std::runtime_error("the mesh has no triangles");
+		return converter;
+	}
+
+	///Weld, simplify, build the shape and serialize it. Runs on a worker
+	std::vector<char> bake(BtOgre::StaticMeshToShapeConverter& converter, const Options& options)
+	{
+		if (options.weldEpsilon >= 0)
+			converter.weldVertices(options.weldEpsilon);
+		if (options.simplifyTriangles)
+			converter.simplify(options.simplifyTriangles);
+
+		std::unique_ptr<btCollisionShape> shape(options.kind == BtOgre::ShapeKind::Trimesh
+			? converter.createOwningTrimesh()
+			: converter.createShape(options.kind));
+
+		btDefaultSerializer serializer;
+		serializer.startSerialization();
+		shape->serializeSingleShape(&serializer);
+		serializer.finishSerialization();
+
+		const auto begin = reinterpret_cast<const char*>(serializer.getBufferPointer());
+		std::vector<char> data(begin, begin + serializer.getCurrentBufferSize());
+
+		//Compounds don't own their children
+		if (const auto compound = dynamic_cast<btCompoundShape*>(shape.get()))
+			for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+				delete compound->getChildShape(i);
+
+		return data;
+	}
+
+	///Write a finished shape to the output folder
+	bool write(const Options& options, Archive* outputArchive, PendingShape& pending)
+	{
+		try
+		{
+			const auto data = pending.data.get();
+			createFolders(options.output, pending.output);
+			auto stream = outputArchive->create(pending.output);
+			stream->write(data.data(), data.size());
+			stream->close();
+			std::cout << "Wrote " << pending.output << "\n";
+			return true;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Failed to bake " << pending.output << " : " << e.what() << "\n";
+			return false;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	auto root = startOgre(options);
+
+	createFolder(options.output);
+	auto& archiveManager = ArchiveManager::getSingleton();
+	auto inputArchive = archiveManager.load(options.input, "FileSystem", true);
+	auto outputArchive = archiveManager.load(options.output, "FileSystem", false);
+	ResourceGroupManager::getSingleton().addResourceLocation(options.input, "FileSystem", "Bake", true);
+	ResourceGroupManager::getSingleton().initialiseResourceGroup("Bake");
+
+	BtOgre::ThreadPool pool(options.threads);
+	std::deque<PendingShape> pending;
+	auto failures = 0;
+	auto skipped = 0;
+
+	const auto meshes = inputArchive->find("*.mesh", true);
+	for (const auto& name : *meshes)
+	{
+		const auto output = name.substr(0, name.size() - 5) + ".bullet";
+		if (!options.force && outputArchive->exists(output)
+			&& outputArchive->getModifiedTime(output) >= inputArchive->getModifiedTime(name))
+		{
+			++skipped;
+			continue;
+		}
+
+		std::shared_ptr<BtOgre::StaticMeshToShapeConverter> converter;
+		try
+		{
+			converter = loadMesh(name, options);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Failed to load " << name << " : " << e.what() << "\n";
+			++failures;
+			continue;
+		}
+
+		//Submeshes are decoded on the same pool, parallelFor nests
+		converter->setThreadPool(&pool);
+		pending.push_back({ output, pool.enqueue([converter, &options] { return bake(*converter, options); }) });
+
+		//Keep a few meshes per worker in flight, not the whole tree
+		while (pending.size() > 2 * pool.getThreadCount())
+		{
+			failures += write(options, outputArchive, pending.front()) ? 0 : 1;
+			pending.pop_front();
+		}
+	}
+
+	for (auto& shape : pending)
+		failures += write(options, outputArchive, shape) ? 0 : 1;
+
+	std::cout << meshes->size() << " meshes, " << skipped << " up to date, " << failures << " failed\n";
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}